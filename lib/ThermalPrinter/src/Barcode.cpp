@@ -0,0 +1,233 @@
+#include "Barcode.h"
+#include "Raster.h"
+
+namespace raster {
+
+namespace {
+
+// widths are stored as hex digits, most significant digit is the first element
+
+constexpr char code39Alphabet[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ-. $/+%";
+// nine elements per character, a set bit marks a wide element
+constexpr uint16_t code39Patterns[] = {
+    0x034, 0x121, 0x061, 0x160, 0x031, 0x130, 0x070, 0x025, 0x124, 0x064, 0x109, 0x049, 0x148, 0x019, 0x118,
+    0x058, 0x00D, 0x10C, 0x04C, 0x01C, 0x103, 0x043, 0x142, 0x013, 0x112, 0x052, 0x007, 0x106, 0x046, 0x016,
+    0x181, 0x0C1, 0x1C0, 0x091, 0x190, 0x0D0, 0x085, 0x184, 0x0C4, 0x0A8, 0x0A2, 0x08A, 0x02A,
+};
+constexpr uint16_t code39Asterisk = 0x094;
+
+// five elements per digit, a set bit marks a wide element
+constexpr uint8_t itfPatterns[] = {0x06, 0x11, 0x09, 0x18, 0x05, 0x14, 0x0C, 0x03, 0x12, 0x0A};
+
+constexpr uint16_t eanL[] = {0x3211, 0x2221, 0x2122, 0x1411, 0x1132, 0x1231, 0x1114, 0x1312, 0x1213, 0x3112};
+constexpr uint16_t eanG[] = {0x1123, 0x1222, 0x2212, 0x1141, 0x2311, 0x1321, 0x4111, 0x2131, 0x3121, 0x2113};
+// L/G parity of the left half of an EAN-13, selected by the first digit (set bit = G)
+constexpr uint8_t ean13Parity[] = {0x00, 0x0B, 0x0D, 0x0E, 0x13, 0x19, 0x1C, 0x15, 0x16, 0x1A};
+
+constexpr uint32_t code128Patterns[] = {
+    0x212222, 0x222122, 0x222221, 0x121223, 0x121322, 0x131222, 0x122213, 0x122312, 0x132212, 0x221213, 0x221312, 0x231212, 0x112232, 0x122132,
+    0x122231, 0x113222, 0x123122, 0x123221, 0x223211, 0x221132, 0x221231, 0x213212, 0x223112, 0x312131, 0x311222, 0x321122, 0x321221, 0x312212,
+    0x322112, 0x322211, 0x212123, 0x212321, 0x232121, 0x111323, 0x131123, 0x131321, 0x112313, 0x132113, 0x132311, 0x211313, 0x231113, 0x231311,
+    0x112133, 0x112331, 0x132131, 0x113123, 0x113321, 0x133121, 0x313121, 0x211331, 0x231131, 0x213113, 0x213311, 0x213131, 0x311123, 0x311321,
+    0x331121, 0x312113, 0x312311, 0x332111, 0x314111, 0x221411, 0x431111, 0x111224, 0x111422, 0x121124, 0x121421, 0x141122, 0x141221, 0x112214,
+    0x112412, 0x122114, 0x122411, 0x142112, 0x142211, 0x241211, 0x221114, 0x413111, 0x241112, 0x134111, 0x111242, 0x121142, 0x121241, 0x114212,
+    0x124112, 0x124211, 0x411212, 0x421112, 0x421211, 0x212141, 0x214121, 0x412121, 0x111143, 0x111341, 0x131141, 0x114113, 0x114311, 0x411113,
+    0x411311, 0x113141, 0x114131, 0x311141, 0x411131, 0x211412, 0x211214, 0x211232,
+};
+constexpr uint32_t code128Stop = 0x2331112;
+constexpr uint8_t code128CodeB = 100;
+constexpr uint8_t code128CodeC = 99;
+constexpr uint8_t code128StartB = 104;
+constexpr uint8_t code128StartC = 105;
+
+constexpr uint8_t narrow = 1;
+constexpr uint8_t wide = 3;
+
+bool isDigits(const char *text) {
+    return *text != 0 && std::all_of(text, text + strlen(text), [](char c) { return isdigit(c); });
+}
+
+size_t digitRun(const char *text) {
+    size_t n = 0;
+    while(isdigit(text[n]))
+        n++;
+    return n;
+}
+
+} // namespace
+
+void Barcode::addPattern(uint32_t pattern, size_t count) {
+    for(size_t i = count; i > 0; i--)
+        add((pattern >> (4 * (i - 1))) & 0x0F);
+}
+
+bool Barcode::encode(Symbology type, const char *text) {
+    elements.clear();
+    width = 0;
+    hri = text;
+
+    bool ok = false;
+    switch(type) {
+        case Symbology::code39:
+            ok = encodeCode39(text);
+            break;
+        case Symbology::itf:
+            ok = encodeItf(text);
+            break;
+        case Symbology::ean13:
+            ok = encodeEan(text, 13);
+            break;
+        case Symbology::ean8:
+            ok = encodeEan(text, 8);
+            break;
+        case Symbology::upca:
+            ok = encodeEan(text, 12);
+            break;
+        case Symbology::code128:
+            ok = encodeCode128(text);
+            break;
+    }
+    if(!ok) {
+        elements.clear();
+        width = 0;
+    }
+    return ok;
+}
+
+uint8_t Barcode::fitModuleWidth(size_t maxWidth) const {
+    if(width == 0)
+        return 0;
+    return std::min<size_t>(maxWidth / (width + 2 * quietZone), UINT8_MAX);
+}
+
+void Barcode::draw(uint8_t *line, int x, uint8_t moduleWidth) const {
+    bool bar = true;
+    for(const auto w : elements) {
+        const int px = w * moduleWidth;
+        if(bar)
+            fillSpan(line, x, px);
+        x += px;
+        bar = !bar;
+    }
+}
+
+bool Barcode::encodeCode39(const char *text) {
+    auto addChar = [this](uint16_t pattern) {
+        for(int i = 8; i >= 0; i--)
+            add((pattern & (1 << i)) ? wide : narrow);
+    };
+
+    addChar(code39Asterisk);
+    for(const char *c = text; *c != 0; c++) {
+        const char *pos = strchr(code39Alphabet, *c);
+        if(*c == '*' || pos == nullptr)
+            return false;
+        add(narrow);
+        addChar(code39Patterns[pos - code39Alphabet]);
+    }
+    add(narrow);
+    addChar(code39Asterisk);
+    return true;
+}
+
+bool Barcode::encodeItf(const char *text) {
+    if(!isDigits(text))
+        return false;
+    if(strlen(text) % 2)
+        hri.insert(0, 1, '0');
+
+    addPattern(0x1111, 4);
+    for(size_t i = 0; i < hri.size(); i += 2) {
+        // bars from the first digit are interleaved with the spaces of the second
+        const uint8_t bars = itfPatterns[hri[i] - '0'];
+        const uint8_t spaces = itfPatterns[hri[i + 1] - '0'];
+        for(int j = 4; j >= 0; j--) {
+            add((bars & (1 << j)) ? wide : narrow);
+            add((spaces & (1 << j)) ? wide : narrow);
+        }
+    }
+    add(wide);
+    add(narrow);
+    add(narrow);
+    return true;
+}
+
+bool Barcode::encodeEan(const char *text, size_t digits) {
+    const size_t len = strlen(text);
+    if(!isDigits(text) || (len != digits && len != digits - 1))
+        return false;
+
+    // weights are 3, 1, 3, ... starting right of the check digit
+    int sum = 0;
+    for(size_t i = 0; i < digits - 1; i++)
+        sum += (text[digits - 2 - i] - '0') * ((i % 2) ? 1 : 3);
+    const char check = '0' + (10 - sum % 10) % 10;
+    if(len == digits && text[digits - 1] != check)
+        return false;
+    if(len != digits)
+        hri += check;
+
+    // UPC-A is an EAN-13 with a leading zero
+    std::string code = (digits == 12) ? "0" + hri : hri;
+    const size_t half = (code.size() == 8) ? 4 : 6;
+    const size_t first = (code.size() == 8) ? 0 : 1;
+    const uint8_t parity = (code.size() == 8) ? 0 : ean13Parity[code[0] - '0'];
+
+    addPattern(0x111, 3);
+    for(size_t i = 0; i < half; i++) {
+        const uint8_t d = code[first + i] - '0';
+        addPattern((parity & (1 << (half - 1 - i))) ? eanG[d] : eanL[d], 4);
+    }
+    addPattern(0x11111, 5);
+    for(size_t i = 0; i < half; i++)
+        addPattern(eanL[code[first + half + i] - '0'], 4);
+    addPattern(0x111, 3);
+    return true;
+}
+
+bool Barcode::encodeCode128(const char *text) {
+    std::vector<uint8_t> values;
+    bool setC = digitRun(text) >= 4 || (isDigits(text) && strlen(text) % 2 == 0);
+    values.push_back(setC ? code128StartC : code128StartB);
+
+    for(const char *c = text; *c != 0;) {
+        if(setC) {
+            if(isdigit(c[0]) && isdigit(c[1])) {
+                values.push_back((c[0] - '0') * 10 + (c[1] - '0'));
+                c += 2;
+                continue;
+            }
+            values.push_back(code128CodeB);
+            setC = false;
+        }
+
+        // switching to set C pays off for four digits at the end or six in between
+        const size_t run = digitRun(c);
+        if((run >= 4 && c[run] == 0) || run >= 6) {
+            if(run % 2) {
+                values.push_back(*c - ' ');
+                c++;
+            }
+            values.push_back(code128CodeC);
+            setC = true;
+            continue;
+        }
+
+        if(*c < ' ' || *c > '~')
+            return false;
+        values.push_back(*c - ' ');
+        c++;
+    }
+
+    uint32_t checksum = values[0];
+    for(size_t i = 1; i < values.size(); i++)
+        checksum += i * values[i];
+    values.push_back(checksum % 103);
+
+    for(const auto v : values)
+        addPattern(code128Patterns[v], 6);
+    addPattern(code128Stop, 7);
+    return true;
+}
+
+} // namespace raster
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+
+namespace raster {
+
+enum class Symbology : uint8_t { code39 = 0, itf, ean13, ean8, upca, code128 };
+
+/**
+ * Software encoder for 1D barcodes. The symbol is kept as a list of element
+ * widths in modules, alternating bar and space and starting with a bar,
+ * which is rasterized into a graphic line with an exact module width.
+ */
+class Barcode {
+public:
+    static constexpr uint8_t quietZone = 10;
+
+    /**
+     * Encode text with the given symbology. EAN/UPC accept the data with or
+     * without check digit (a given check digit is verified), ITF pads odd
+     * digit counts with a leading zero. Returns false if text can't be encoded.
+     */
+    bool encode(Symbology type, const char *text);
+
+    size_t modules() const { return width; }
+
+    /**
+     * Human readable text, including computed check digits.
+     */
+    const char *text() const { return hri.c_str(); }
+
+    /**
+     * Largest module width in dots so the symbol and its quiet zones fit into
+     * maxWidth dots, 0 if even a single dot module is too wide.
+     */
+    uint8_t fitModuleWidth(size_t maxWidth) const;
+
+    /**
+     * Set the bars of the symbol in a graphic line, starting at dot x.
+     */
+    void draw(uint8_t *line, int x, uint8_t moduleWidth) const;
+
+private:
+    std::vector<uint8_t> elements;
+    size_t width{0};
+    std::string hri;
+
+    void add(uint8_t w) {
+        elements.push_back(w);
+        width += w;
+    }
+    void addPattern(uint32_t pattern, size_t count);
+
+    bool encodeCode39(const char *text);
+    bool encodeItf(const char *text);
+    bool encodeEan(const char *text, size_t digits);
+    bool encodeCode128(const char *text);
+};
+
+} // namespace raster
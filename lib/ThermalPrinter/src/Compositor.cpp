@@ -0,0 +1,143 @@
+#include "Compositor.h"
+
+#include <memory>
+
+namespace raster {
+
+int Compositor::addText(int x, int y, size_t boxWidth, const Font &font, const char *text, Align align, uint8_t spacing) {
+    size_t lines = 0;
+    for(const char *p = text; *p != 0; lines++) {
+        const char *next;
+        wrapLine(font, p, boxWidth, spacing, next);
+        p = next;
+    }
+    elements.push_back(TextElement{x, y, boxWidth, &font, text, align, spacing});
+
+    const int end = y + int(lines * font.height);
+    bottom = std::max(bottom, end);
+    return end;
+}
+
+int Compositor::addQrCode(int x, int y, const qrcodegen::QrCode &qr, uint8_t zoom, uint8_t border) {
+    // draw() divides by the zoom
+    zoom = std::max<uint8_t>(zoom, 1);
+    elements.push_back(QrElement{x, y, &qr, zoom, border});
+
+    const int end = y + (qr.getSize() + 2 * border) * zoom;
+    bottom = std::max(bottom, end);
+    return end;
+}
+
+int Compositor::addMatrix(int x, int y, const Matrix &matrix, uint8_t zoom, uint8_t border) {
+    zoom = std::max<uint8_t>(zoom, 1);
+    elements.push_back(MatrixElement{x, y, &matrix, zoom, border});
+
+    const int end = y + (matrix.height() + 2 * border) * zoom;
+    bottom = std::max(bottom, end);
+    return end;
+}
+
+int Compositor::addBitmap(int x, int y, size_t w, size_t h, const uint8_t *bitmap, bool invert) {
+    elements.push_back(BitmapElement{x, y, w, h, bitmap, invert});
+
+    const int end = y + int(h);
+    bottom = std::max(bottom, end);
+    return end;
+}
+
+int Compositor::addBarcode(int x, int y, size_t boxWidth, size_t h, const Barcode &code) {
+    const uint8_t module = code.fitModuleWidth(boxWidth);
+    const size_t w = code.modules() * module;
+    elements.push_back(BarcodeElement{x + int(boxWidth - std::min(w, boxWidth)) / 2, y, (module != 0) ? h : 0, &code, module});
+
+    const int end = y + int(h);
+    bottom = std::max(bottom, end);
+    return end;
+}
+
+int Compositor::addRect(int x, int y, size_t w, size_t h) {
+    elements.push_back(RectElement{x, y, w, h});
+
+    const int end = y + int(h);
+    bottom = std::max(bottom, end);
+    return end;
+}
+
+void Compositor::clear() {
+    elements.clear();
+    bottom = 0;
+}
+
+void Compositor::print(ThermalPrinter &printer, size_t bandLines) const {
+    bandLines = std::clamp<size_t>(bandLines, 1, Band::maxLines);
+    // a band is too large for the stack, keep it on the heap while printing
+    auto band = std::make_unique<Band>(bandLines);
+
+    for(int top = 0; top < bottom; top += bandLines) {
+        band->clear(std::min<size_t>(bandLines, bottom - top));
+        for(const auto &element : elements)
+            std::visit([&](const auto &e) { draw(*band, top, e); }, element);
+        printer.printBand(*band);
+    }
+}
+
+void Compositor::draw(Band &band, int top, const TextElement &e) {
+    const int bandEnd = top + int(band.lines());
+    int y = e.y;
+    for(const char *p = e.text; *p != 0 && y < bandEnd; y += e.font->height) {
+        const char *next;
+        const size_t len = wrapLine(*e.font, p, e.width, e.spacing, next);
+        if(y + e.font->height > top) {
+            const size_t w = e.font->textWidth(p, len, e.spacing);
+            int x = e.x;
+            if(w < e.width && e.align == Align::center)
+                x += (e.width - w) / 2;
+            else if(w < e.width && e.align == Align::right)
+                x += e.width - w;
+            band.drawText(*e.font, x, y - top, p, len, e.spacing);
+        }
+        p = next;
+    }
+}
+
+void Compositor::draw(Band &band, int top, const QrElement &e) {
+    const int size = e.qr->getSize();
+    const int origin = e.border * e.zoom;
+    // only the module rows overlapping the band
+    const int first = std::max(0, (top - e.y - origin) / int(e.zoom));
+    const int last = std::min(size, (top + int(band.lines()) - e.y - origin + e.zoom - 1) / int(e.zoom));
+    for(int my = first; my < last; my++) {
+        for(int mx = 0; mx < size; mx++) {
+            if(e.qr->getModule(mx, my))
+                band.fillRect(e.x + origin + mx * e.zoom, e.y + origin + my * e.zoom - top, e.zoom, e.zoom);
+        }
+    }
+}
+
+void Compositor::draw(Band &band, int top, const MatrixElement &e) {
+    const int origin = e.border * e.zoom;
+    const int first = std::max(0, (top - e.y - origin) / int(e.zoom));
+    const int last = std::min<int>(e.matrix->height(), (top + int(band.lines()) - e.y - origin + e.zoom - 1) / int(e.zoom));
+    for(int my = first; my < last; my++) {
+        for(size_t mx = 0; mx < e.matrix->width(); mx++) {
+            if(e.matrix->getModule(mx, my))
+                band.fillRect(e.x + origin + mx * e.zoom, e.y + origin + my * e.zoom - top, e.zoom, e.zoom);
+        }
+    }
+}
+
+void Compositor::draw(Band &band, int top, const BitmapElement &e) {
+    const size_t stride = (e.width + 7) / 8;
+    band.blit(e.x, e.y - top, e.bitmap, e.width, e.height, stride, e.invert);
+}
+
+void Compositor::draw(Band &band, int top, const RectElement &e) { band.fillRect(e.x, e.y - top, e.width, e.height); }
+
+void Compositor::draw(Band &band, int top, const BarcodeElement &e) {
+    const int first = std::max(e.y - top, 0);
+    const int last = std::min<int>(e.y + e.height - top, band.lines());
+    for(int y = first; y < last; y++)
+        e.code->draw(band.line(y), e.x, e.module);
+}
+
+} // namespace raster
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Barcode.h"
+#include "QrCodeGen.hpp"
+#include "Raster.h"
+#include "ThermalPrinter.h"
+#include <Arduino.h>
+#include <variant>
+#include <vector>
+
+namespace raster {
+
+/**
+ * Lays out text, QR codes and bitmaps anywhere on the receipt (also side by side)
+ * and prints the result as one compressed graphic stream, band by band.
+ * Only one band is kept in RAM. Elements are referenced, not copied: text,
+ * QR codes and bitmaps have to stay valid until print() returned.
+ */
+class Compositor {
+public:
+    static constexpr size_t width = pxLine;
+
+    /**
+     * Place word wrapped text into the box starting at (x, y) with the given width.
+     * Returns the y coordinate below the text.
+     */
+    int addText(int x, int y, size_t boxWidth, const Font &font, const char *text, Align align = Align::left, uint8_t spacing = 0);
+
+    /**
+     * Place a QR code with its quiet zone at (x, y). zoom is the size of a module in dots,
+     * 0 counts as 1. Returns the y coordinate below the code.
+     */
+    int addQrCode(int x, int y, const qrcodegen::QrCode &qr, uint8_t zoom, uint8_t border = 4);
+
+    /**
+     * Place a 2D symbol like a Data Matrix with its quiet zone at (x, y), zoom
+     * as for addQrCode(). Returns the y coordinate below the symbol.
+     */
+    int addMatrix(int x, int y, const Matrix &matrix, uint8_t zoom, uint8_t border = 2);
+
+    /**
+     * Place a 1bpp bitmap (rows padded to full bytes) at (x, y).
+     * Returns the y coordinate below the bitmap.
+     */
+    int addBitmap(int x, int y, size_t w, size_t h, const uint8_t *bitmap, bool invert = false);
+
+    /**
+     * Place a 1D barcode centered in the box at (x, y), using the largest module
+     * width that fits into boxWidth. Returns the y coordinate below the bars.
+     */
+    int addBarcode(int x, int y, size_t boxWidth, size_t h, const Barcode &code);
+
+    /**
+     * Draw a filled rectangle, e.g. a horizontal rule. Returns the y coordinate below it.
+     */
+    int addRect(int x, int y, size_t w, size_t h);
+
+    /**
+     * Lowest y coordinate used by any element, this is the printed height.
+     */
+    int height() const { return bottom; }
+
+    void clear();
+
+    /**
+     * Render the receipt band by band and send it to the printer.
+     */
+    void print(ThermalPrinter &printer, size_t bandLines = Band::maxLines) const;
+
+private:
+    struct TextElement {
+        int x, y;
+        size_t width;
+        const Font *font;
+        const char *text;
+        Align align;
+        uint8_t spacing;
+    };
+    struct QrElement {
+        int x, y;
+        const qrcodegen::QrCode *qr;
+        uint8_t zoom;
+        uint8_t border;
+    };
+    struct MatrixElement {
+        int x, y;
+        const Matrix *matrix;
+        uint8_t zoom;
+        uint8_t border;
+    };
+    struct BitmapElement {
+        int x, y;
+        size_t width, height;
+        const uint8_t *bitmap;
+        bool invert;
+    };
+    struct RectElement {
+        int x, y;
+        size_t width, height;
+    };
+    struct BarcodeElement {
+        int x, y;
+        size_t height;
+        const Barcode *code;
+        uint8_t module;
+    };
+    using Element = std::variant<TextElement, QrElement, MatrixElement, BitmapElement, RectElement, BarcodeElement>;
+
+    std::vector<Element> elements;
+    int bottom{0};
+
+    static void draw(Band &band, int top, const TextElement &e);
+    static void draw(Band &band, int top, const QrElement &e);
+    static void draw(Band &band, int top, const MatrixElement &e);
+    static void draw(Band &band, int top, const BitmapElement &e);
+    static void draw(Band &band, int top, const RectElement &e);
+    static void draw(Band &band, int top, const BarcodeElement &e);
+};
+
+} // namespace raster
@@ -0,0 +1,279 @@
+#include "DataMatrix.h"
+
+namespace raster {
+
+namespace {
+
+struct SymbolSize {
+    uint8_t size;
+    uint8_t regionSize;
+    uint8_t regions;
+    uint16_t dataCodewords;
+    uint16_t eccCodewords;
+    uint8_t blocks;
+};
+
+constexpr SymbolSize symbolSizes[] = {
+    {10, 8, 1, 3, 5, 1},        {12, 10, 1, 5, 7, 1},       {14, 12, 1, 8, 10, 1},      {16, 14, 1, 12, 12, 1},     {18, 16, 1, 18, 14, 1},
+    {20, 18, 1, 22, 18, 1},     {22, 20, 1, 30, 20, 1},     {24, 22, 1, 36, 24, 1},     {26, 24, 1, 44, 28, 1},     {32, 14, 2, 62, 36, 1},
+    {36, 16, 2, 86, 42, 1},     {40, 18, 2, 114, 48, 1},    {44, 20, 2, 144, 56, 1},    {48, 22, 2, 174, 68, 1},    {52, 24, 2, 204, 84, 2},
+    {64, 14, 4, 280, 112, 2},   {72, 16, 4, 368, 144, 4},   {80, 18, 4, 456, 192, 4},   {88, 20, 4, 576, 224, 4},   {96, 22, 4, 696, 272, 4},
+    {104, 24, 4, 816, 336, 6},  {120, 18, 6, 1050, 408, 6}, {132, 20, 6, 1304, 496, 8}, {144, 22, 6, 1558, 620, 10},
+};
+
+constexpr uint8_t padCodeword = 129;
+constexpr uint8_t upperShift = 235;
+
+// GF(256) with the Data Matrix polynomial x^8 + x^5 + x^3 + x^2 + 1
+struct Galois {
+    std::array<uint8_t, 256> exp{};
+    std::array<uint8_t, 256> log{};
+
+    constexpr Galois() {
+        uint16_t v = 1;
+        for(size_t i = 0; i < 255; i++) {
+            exp[i] = v;
+            log[v] = i;
+            v <<= 1;
+            if(v & 0x100)
+                v ^= 0x12D;
+        }
+    }
+
+    constexpr uint8_t mul(uint8_t a, uint8_t b) const { return (a == 0 || b == 0) ? 0 : exp[(log[a] + log[b]) % 255]; }
+};
+constexpr Galois gf;
+
+std::vector<uint8_t> encodeAscii(const uint8_t *data, size_t len) {
+    std::vector<uint8_t> cw;
+    for(size_t i = 0; i < len; i++) {
+        const uint8_t c = data[i];
+        if(isdigit(c) && i + 1 < len && isdigit(data[i + 1])) {
+            cw.push_back(130 + (c - '0') * 10 + (data[i + 1] - '0'));
+            i++;
+        } else if(c < 128) {
+            cw.push_back(c + 1);
+        } else {
+            cw.push_back(upperShift);
+            cw.push_back(c - 128 + 1);
+        }
+    }
+    return cw;
+}
+
+void addErrorCorrection(std::vector<uint8_t> &cw, const SymbolSize &s) {
+    const size_t eccLen = s.eccCodewords / s.blocks;
+
+    // generator polynomial (x - 2^1)...(x - 2^n), highest coefficient first without the leading 1
+    std::vector<uint8_t> gen(eccLen, 0);
+    std::vector<uint8_t> poly{1};
+    for(size_t i = 1; i <= eccLen; i++) {
+        std::vector<uint8_t> next(poly.size() + 1, 0);
+        for(size_t j = 0; j < poly.size(); j++) {
+            next[j] ^= poly[j];
+            next[j + 1] ^= gf.mul(poly[j], gf.exp[i]);
+        }
+        poly = std::move(next);
+    }
+    std::copy(poly.begin() + 1, poly.end(), gen.begin());
+
+    // blocks are interleaved, codeword i belongs to block i % blocks
+    cw.resize(s.dataCodewords + s.eccCodewords, 0);
+    for(size_t b = 0; b < s.blocks; b++) {
+        std::vector<uint8_t> ecc(eccLen, 0);
+        for(size_t i = b; i < s.dataCodewords; i += s.blocks) {
+            const uint8_t m = cw[i] ^ ecc[0];
+            std::rotate(ecc.begin(), ecc.begin() + 1, ecc.end());
+            ecc.back() = 0;
+            for(size_t j = 0; j < eccLen; j++)
+                ecc[j] ^= gf.mul(m, gen[j]);
+        }
+        for(size_t j = 0; j < eccLen; j++)
+            cw[s.dataCodewords + b + j * s.blocks] = ecc[j];
+    }
+}
+
+/**
+ * Module placement of ISO/IEC 16022 annex F. Every cell of the mapping matrix
+ * receives codeword * 8 + bit (bit 0 being the MSB), fixed dark cells are -1
+ * and cells not covered by any codeword stay -2 (light).
+ */
+class Placement {
+public:
+    Placement(int rows, int cols) : nrow{rows}, ncol{cols}, cells(rows * cols, unset) { }
+
+    void place() {
+        int chr = 0;
+        int row = 4;
+        int col = 0;
+        do {
+            if(row == nrow && col == 0)
+                corner1(chr++);
+            if(row == nrow - 2 && col == 0 && (ncol % 4))
+                corner2(chr++);
+            if(row == nrow - 2 && col == 0 && (ncol % 8 == 4))
+                corner3(chr++);
+            if(row == nrow + 4 && col == 2 && !(ncol % 8))
+                corner4(chr++);
+            do {
+                if(row < nrow && col >= 0 && cell(row, col) == unset)
+                    utah(row, col, chr++);
+                row -= 2;
+                col += 2;
+            } while(row >= 0 && col < ncol);
+            row += 1;
+            col += 3;
+            do {
+                if(row >= 0 && col < ncol && cell(row, col) == unset)
+                    utah(row, col, chr++);
+                row += 2;
+                col -= 2;
+            } while(row < nrow && col >= 0);
+            row += 3;
+            col += 1;
+        } while(row < nrow || col < ncol);
+
+        if(cell(nrow - 1, ncol - 1) == unset) {
+            cell(nrow - 1, ncol - 1) = dark;
+            cell(nrow - 2, ncol - 2) = dark;
+        }
+    }
+
+    bool isDark(int row, int col, const std::vector<uint8_t> &cw) const {
+        const int v = cells[row * ncol + col];
+        if(v < 0)
+            return v == dark;
+        return cw[v / 8] & (0x80 >> (v % 8));
+    }
+
+private:
+    static constexpr int16_t unset = -2;
+    static constexpr int16_t dark = -1;
+
+    int nrow;
+    int ncol;
+    std::vector<int16_t> cells;
+
+    int16_t &cell(int row, int col) { return cells[row * ncol + col]; }
+
+    void module(int row, int col, int chr, int bit) {
+        if(row < 0) {
+            row += nrow;
+            col += 4 - ((nrow + 4) % 8);
+        }
+        if(col < 0) {
+            col += ncol;
+            row += 4 - ((ncol + 4) % 8);
+        }
+        cell(row, col) = chr * 8 + bit;
+    }
+
+    void utah(int row, int col, int chr) {
+        module(row - 2, col - 2, chr, 0);
+        module(row - 2, col - 1, chr, 1);
+        module(row - 1, col - 2, chr, 2);
+        module(row - 1, col - 1, chr, 3);
+        module(row - 1, col, chr, 4);
+        module(row, col - 2, chr, 5);
+        module(row, col - 1, chr, 6);
+        module(row, col, chr, 7);
+    }
+
+    void corner1(int chr) {
+        module(nrow - 1, 0, chr, 0);
+        module(nrow - 1, 1, chr, 1);
+        module(nrow - 1, 2, chr, 2);
+        module(0, ncol - 2, chr, 3);
+        module(0, ncol - 1, chr, 4);
+        module(1, ncol - 1, chr, 5);
+        module(2, ncol - 1, chr, 6);
+        module(3, ncol - 1, chr, 7);
+    }
+
+    void corner2(int chr) {
+        module(nrow - 3, 0, chr, 0);
+        module(nrow - 2, 0, chr, 1);
+        module(nrow - 1, 0, chr, 2);
+        module(0, ncol - 4, chr, 3);
+        module(0, ncol - 3, chr, 4);
+        module(0, ncol - 2, chr, 5);
+        module(0, ncol - 1, chr, 6);
+        module(1, ncol - 1, chr, 7);
+    }
+
+    void corner3(int chr) {
+        module(nrow - 3, 0, chr, 0);
+        module(nrow - 2, 0, chr, 1);
+        module(nrow - 1, 0, chr, 2);
+        module(0, ncol - 2, chr, 3);
+        module(0, ncol - 1, chr, 4);
+        module(1, ncol - 1, chr, 5);
+        module(2, ncol - 1, chr, 6);
+        module(3, ncol - 1, chr, 7);
+    }
+
+    void corner4(int chr) {
+        module(nrow - 1, 0, chr, 0);
+        module(nrow - 1, ncol - 1, chr, 1);
+        module(0, ncol - 3, chr, 2);
+        module(0, ncol - 2, chr, 3);
+        module(0, ncol - 1, chr, 4);
+        module(1, ncol - 3, chr, 5);
+        module(1, ncol - 2, chr, 6);
+        module(1, ncol - 1, chr, 7);
+    }
+};
+
+} // namespace
+
+Matrix DataMatrix::encodeText(const char *text) { return encodeBinary(reinterpret_cast<const uint8_t *>(text), strlen(text)); }
+
+Matrix DataMatrix::encodeBinary(const uint8_t *data, size_t len) {
+    std::vector<uint8_t> cw = encodeAscii(data, len);
+    const SymbolSize *s = std::find_if(std::begin(symbolSizes), std::end(symbolSizes), [&](const SymbolSize &s) { return s.dataCodewords >= cw.size(); });
+    if(s == std::end(symbolSizes))
+        return Matrix();
+
+    // the first pad is fixed, the following ones are scrambled with their position
+    const size_t dataLen = cw.size();
+    for(size_t pos = dataLen + 1; pos <= s->dataCodewords; pos++) {
+        if(pos == dataLen + 1) {
+            cw.push_back(padCodeword);
+            continue;
+        }
+        int pad = padCodeword + ((149 * pos) % 253) + 1;
+        if(pad > 254)
+            pad -= 254;
+        cw.push_back(pad);
+    }
+    addErrorCorrection(cw, *s);
+
+    const int mapSize = s->regionSize * s->regions;
+    Placement placement(mapSize, mapSize);
+    placement.place();
+
+    Matrix m(s->size, s->size);
+    const int region = s->regionSize + 2;
+    for(int y = 0; y < s->size; y++) {
+        for(int x = 0; x < s->size; x++) {
+            const int rx = x % region;
+            const int ry = y % region;
+            bool dark;
+            if(rx == 0 || ry == region - 1) {
+                // solid finder pattern on the left and bottom edge of each region
+                dark = true;
+            } else if(ry == 0) {
+                // alternating clock track on top and right edge
+                dark = (rx % 2) == 0;
+            } else if(rx == region - 1) {
+                dark = (ry % 2) == 1;
+            } else {
+                dark = placement.isDark((y / region) * s->regionSize + ry - 1, (x / region) * s->regionSize + rx - 1, cw);
+            }
+            m.setModule(x, y, dark);
+        }
+    }
+    return m;
+}
+
+} // namespace raster
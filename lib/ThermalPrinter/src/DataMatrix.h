@@ -0,0 +1,27 @@
+#pragma once
+
+#include "Raster.h"
+#include <Arduino.h>
+
+namespace raster {
+
+/**
+ * Data Matrix (ECC 200) encoder for square symbols from 10x10 to 144x144.
+ * Data is encoded in ASCII mode with digit pairs packed into one codeword,
+ * which gives the smallest symbols for short numeric and alphanumeric IDs.
+ */
+class DataMatrix {
+public:
+    /**
+     * Encode text (bytes above 127 use upper shift) into the smallest symbol.
+     * Returns an empty matrix if the data does not fit into 144x144.
+     */
+    static Matrix encodeText(const char *text);
+
+    /**
+     * Same as encodeText() for arbitrary binary data.
+     */
+    static Matrix encodeBinary(const uint8_t *data, size_t len);
+};
+
+} // namespace raster
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <Arduino.h>
+#include <array>
+
+// Build with -DTHERMALPRINTER_INSTRUMENT to collect counters and trace events,
+// without it none of this is compiled into ThermalPrinter.
+#ifndef THERMALPRINTER_TRACE_DEPTH
+#define THERMALPRINTER_TRACE_DEPTH 32
+#endif
+
+namespace instrumentation {
+
+/**
+ * One command sent to the printer, cmd is the command character.
+ * The payload of a graphic line is recorded as a second 'g' event,
+ * a run of text as a textCmd event.
+ */
+struct Event {
+    uint32_t timestamp;
+    uint8_t cmd;
+    uint16_t bytes;
+};
+
+static constexpr uint8_t textCmd = 0;
+
+using Hook = void (*)(const Event &event, void *context);
+
+struct Statistics {
+    // bytes on the wire per command character, including the escape sequence
+    std::array<uint32_t, 128> cmdBytes{};
+    uint32_t textBytes{0};
+    uint32_t graphicLines{0};
+
+    // time spent in timeoutWait(), the part of it spent in yield() and in writes to the stream (e.g. blocked on CTS)
+    uint32_t waitUs{0};
+    uint32_t yieldUs{0};
+    uint32_t yieldCount{0};
+    uint32_t streamUs{0};
+    // time spent compressing graphic lines
+    uint32_t compressUs{0};
+
+    uint32_t qrCount{0};
+    uint32_t qrEncodeUs{0};
+    uint32_t qrEncodeMaxUs{0};
+
+    // the last THERMALPRINTER_TRACE_DEPTH events, traceCount is the total number recorded
+    std::array<Event, THERMALPRINTER_TRACE_DEPTH> trace{};
+    uint32_t traceCount{0};
+
+    void record(const Event &event) {
+        if(trace.size() != 0)
+            trace[traceCount % trace.size()] = event;
+        traceCount++;
+    }
+};
+
+} // namespace instrumentation
@@ -0,0 +1,87 @@
+#include "PrintScheduler.h"
+
+size_t PrintScheduler::addPrinter(ThermalPrinter &printer) {
+    channels.emplace_back().printer = &printer;
+    return channels.size() - 1;
+}
+
+void PrintScheduler::submit(size_t channel, ThermalPrinter::Batch job) {
+    Channel &ch = channels[channel];
+    if(ch.jobs.empty() && int32_t(micros() - ch.readyAt) > 0)
+        ch.readyAt = micros();
+    ch.jobs.push_back(std::move(job));
+}
+
+uint32_t PrintScheduler::poll() {
+    for(Channel &ch : channels)
+        ch.stalled = false;
+    for(;;) {
+        Channel *next = nullptr;
+        bool stalled = false;
+        for(Channel &ch : channels) {
+            if(ch.jobs.empty())
+                continue;
+            if(ch.stalled)
+                stalled = true;
+            else if(next == nullptr || int32_t(ch.readyAt - next->readyAt) < 0)
+                next = &ch;
+        }
+        if(next == nullptr)
+            return stalled ? 0 : UINT32_MAX;
+
+        const uint32_t now = micros();
+        const int32_t wait = next->readyAt - now;
+        if(wait > 0)
+            return stalled ? 0 : wait;
+        if(!sendPiece(*next, now)) {
+            next->stalled = true;
+            next->stats.stalls++;
+        }
+    }
+}
+
+bool PrintScheduler::isIdle() const {
+    return std::all_of(channels.begin(), channels.end(), [](const Channel &ch) { return ch.jobs.empty(); });
+}
+
+bool PrintScheduler::sendPiece(Channel &ch, uint32_t now) {
+    const ThermalPrinter::Batch &job = ch.jobs.front();
+
+    // bytes up to the next pause, the rest of the job after the last one
+    const bool paused = ch.pause < job.pauses.size();
+    const size_t end = paused ? job.pauses[ch.pause].offset : job.data.size();
+    if(end > ch.offset) {
+        Stream &stream = ch.printer->getStream();
+        const int room = stream.availableForWrite();
+        const size_t sent = (room > 0) ? stream.write(job.data.data() + ch.offset, std::min<size_t>(room, end - ch.offset)) : 0;
+        if(sent == 0)
+            return false;
+        if(!ch.started)
+            ch.stats.lateTime += now - ch.readyAt;
+        ch.started = true;
+        ch.stats.bytes += sent;
+        ch.offset += sent;
+        // the rest of the piece when the stream has room again
+        if(ch.offset < end)
+            return true;
+    } else if(!ch.started) {
+        ch.stats.lateTime += now - ch.readyAt;
+    }
+
+    ch.started = false;
+    const uint32_t pause = paused ? job.pauses[ch.pause].us : 0;
+    ch.readyAt = micros() + pause;
+    if(paused)
+        ch.pause++;
+
+    if(ch.offset == job.data.size() && ch.pause == job.pauses.size()) {
+        ch.jobs.pop_front();
+        ch.offset = 0;
+        ch.pause = 0;
+        ch.stats.jobs++;
+        // the job may have left any style or encoding active, a direct
+        // print has to wait for the job's last pause too
+        ch.printer->forgetPrinterState(pause);
+    }
+    return true;
+}
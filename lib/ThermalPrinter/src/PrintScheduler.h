@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ThermalPrinter.h"
+#include <Arduino.h>
+#include <deque>
+#include <vector>
+
+/**
+ * Drives several printers from one controller without blocking on any of
+ * them. Jobs are recorded up front with ThermalPrinter::recordBatch(), the
+ * pauses of a recorded job split it into pieces that are due one after the
+ * other. poll() always sends the piece with the earliest deadline, so the
+ * feed and heating time of one printer is used to send to the others.
+ *
+ * The printers only differ in their Stream, UART0, UART1 and PIO UARTs can
+ * be mixed. A printer must not be used directly while it has queued jobs.
+ */
+class PrintScheduler {
+public:
+    struct Stats {
+        uint32_t jobs;
+        uint32_t bytes;
+        // sum of the time pieces were started after their deadline
+        uint32_t lateTime;
+        // polls the piece was due but the stream had no room
+        uint32_t stalls;
+    };
+
+    /**
+     * Add a printer, returns its channel for submit().
+     */
+    size_t addPrinter(ThermalPrinter &printer);
+
+    /**
+     * Queue a recorded job, jobs of one channel are printed in order.
+     */
+    void submit(size_t channel, ThermalPrinter::Batch job);
+
+    /**
+     * Send what is due as far as the streams take it without blocking, returns
+     * the time in µs until the next piece, 0 if a stream was full, or
+     * UINT32_MAX when all channels are idle. The printer's cached state is
+     * forgotten after every job and its pacing waits for the job's last pause.
+     */
+    uint32_t poll();
+
+    bool isIdle() const;
+    size_t queuedJobs(size_t channel) const { return channels[channel].jobs.size(); }
+    const Stats &getStats(size_t channel) const { return channels[channel].stats; }
+
+private:
+    struct Channel {
+        ThermalPrinter *printer{nullptr};
+        std::deque<ThermalPrinter::Batch> jobs;
+        // position in the front job
+        size_t offset{0};
+        size_t pause{0};
+        // the current piece is partly sent
+        bool started{false};
+        // no room in the stream during this poll
+        bool stalled{false};
+        uint32_t readyAt{0};
+        Stats stats{};
+    };
+
+    std::vector<Channel> channels;
+
+    bool sendPiece(Channel &channel, uint32_t now);
+};
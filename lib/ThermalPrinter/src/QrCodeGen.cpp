@@ -29,13 +29,19 @@
 #include <cstring>
 #include <sstream>
 #include <utility>
-#include "qrcodegen.hpp"
+#include "QrCodeGen.hpp"
 
 using std::int8_t;
 using std::uint8_t;
 using std::size_t;
 using std::vector;
 
+#ifdef QRCODEGEN_PROFILE
+	#define QRCODEGEN_STAGE(st) Profile::Scope profileScope(Profile::st)
+#else
+	#define QRCODEGEN_STAGE(st)
+#endif
+
 
 namespace qrcodegen {
 
@@ -245,13 +251,21 @@ int QrCode::getFormatBits(Ecc ecl) {
 
 
 QrCode QrCode::encodeText(const char *text, Ecc ecl) {
-	vector<QrSegment> segs = QrSegment::makeSegments(text);
+	vector<QrSegment> segs;
+	{
+		QRCODEGEN_STAGE(SEGMENTING);
+		segs = QrSegment::makeSegments(text);
+	}
 	return encodeSegments(segs, ecl);
 }
 
 
 QrCode QrCode::encodeBinary(const vector<uint8_t> &data, Ecc ecl) {
-	vector<QrSegment> segs{QrSegment::makeBytes(data)};
+	vector<QrSegment> segs;
+	{
+		QRCODEGEN_STAGE(SEGMENTING);
+		segs.push_back(QrSegment::makeBytes(data));
+	}
 	return encodeSegments(segs, ecl);
 }
 
@@ -261,56 +275,62 @@ QrCode QrCode::encodeSegments(const vector<QrSegment> &segs, Ecc ecl,
 	if (!(MIN_VERSION <= minVersion && minVersion <= maxVersion && maxVersion <= MAX_VERSION) || mask < -1 || mask > 7)
 		throw std::invalid_argument("Invalid value");
 	
-	// Find the minimal version number to use
-	int version, dataUsedBits;
-	for (version = minVersion; ; version++) {
-		int dataCapacityBits = getNumDataCodewords(version, ecl) * 8;  // Number of data bits available
-		dataUsedBits = QrSegment::getTotalBits(segs, version);
-		if (dataUsedBits != -1 && dataUsedBits <= dataCapacityBits)
-			break;  // This version number is found to be suitable
-		if (version >= maxVersion) {  // All versions in the range could not fit the given data
-			std::ostringstream sb;
-			if (dataUsedBits == -1)
-				sb << "Segment too long";
-			else {
-				sb << "Data length = " << dataUsedBits << " bits, ";
-				sb << "Max capacity = " << dataCapacityBits << " bits";
+	vector<uint8_t> dataCodewords;
+	int version;
+	{
+		QRCODEGEN_STAGE(BIT_PACKING);
+		
+		// Find the minimal version number to use
+		int dataUsedBits;
+		for (version = minVersion; ; version++) {
+			int dataCapacityBits = getNumDataCodewords(version, ecl) * 8;  // Number of data bits available
+			dataUsedBits = QrSegment::getTotalBits(segs, version);
+			if (dataUsedBits != -1 && dataUsedBits <= dataCapacityBits)
+				break;  // This version number is found to be suitable
+			if (version >= maxVersion) {  // All versions in the range could not fit the given data
+				std::ostringstream sb;
+				if (dataUsedBits == -1)
+					sb << "Segment too long";
+				else {
+					sb << "Data length = " << dataUsedBits << " bits, ";
+					sb << "Max capacity = " << dataCapacityBits << " bits";
+				}
+				throw data_too_long(sb.str());
 			}
-			throw data_too_long(sb.str());
 		}
+		assert(dataUsedBits != -1);
+		
+		// Increase the error correction level while the data still fits in the current version number
+		for (Ecc newEcl : {Ecc::ECC_MEDIUM, Ecc::ECC_QUARTILE, Ecc::ECC_HIGH}) {  // From low to high
+			if (boostEcl && dataUsedBits <= getNumDataCodewords(version, newEcl) * 8)
+				ecl = newEcl;
+		}
+		
+		// Concatenate all segments to create the data bit string
+		BitBuffer bb;
+		for (const QrSegment &seg : segs) {
+			bb.appendBits(static_cast<uint32_t>(seg.getMode().getModeBits()), 4);
+			bb.appendBits(static_cast<uint32_t>(seg.getNumChars()), seg.getMode().numCharCountBits(version));
+			bb.insert(bb.end(), seg.getData().begin(), seg.getData().end());
+		}
+		assert(bb.size() == static_cast<unsigned int>(dataUsedBits));
+		
+		// Add terminator and pad up to a byte if applicable
+		size_t dataCapacityBits = static_cast<size_t>(getNumDataCodewords(version, ecl)) * 8;
+		assert(bb.size() <= dataCapacityBits);
+		bb.appendBits(0, std::min(4, static_cast<int>(dataCapacityBits - bb.size())));
+		bb.appendBits(0, (8 - static_cast<int>(bb.size() % 8)) % 8);
+		assert(bb.size() % 8 == 0);
+		
+		// Pad with alternating bytes until data capacity is reached
+		for (uint8_t padByte = 0xEC; bb.size() < dataCapacityBits; padByte ^= 0xEC ^ 0x11)
+			bb.appendBits(padByte, 8);
+		
+		// Pack bits into bytes in big endian
+		dataCodewords.resize(bb.size() / 8);
+		for (size_t i = 0; i < bb.size(); i++)
+			dataCodewords.at(i >> 3) |= (bb.at(i) ? 1 : 0) << (7 - (i & 7));
 	}
-	assert(dataUsedBits != -1);
-	
-	// Increase the error correction level while the data still fits in the current version number
-	for (Ecc newEcl : {Ecc::ECC_MEDIUM, Ecc::ECC_QUARTILE, Ecc::ECC_HIGH}) {  // From low to high
-		if (boostEcl && dataUsedBits <= getNumDataCodewords(version, newEcl) * 8)
-			ecl = newEcl;
-	}
-	
-	// Concatenate all segments to create the data bit string
-	BitBuffer bb;
-	for (const QrSegment &seg : segs) {
-		bb.appendBits(static_cast<uint32_t>(seg.getMode().getModeBits()), 4);
-		bb.appendBits(static_cast<uint32_t>(seg.getNumChars()), seg.getMode().numCharCountBits(version));
-		bb.insert(bb.end(), seg.getData().begin(), seg.getData().end());
-	}
-	assert(bb.size() == static_cast<unsigned int>(dataUsedBits));
-	
-	// Add terminator and pad up to a byte if applicable
-	size_t dataCapacityBits = static_cast<size_t>(getNumDataCodewords(version, ecl)) * 8;
-	assert(bb.size() <= dataCapacityBits);
-	bb.appendBits(0, std::min(4, static_cast<int>(dataCapacityBits - bb.size())));
-	bb.appendBits(0, (8 - static_cast<int>(bb.size() % 8)) % 8);
-	assert(bb.size() % 8 == 0);
-	
-	// Pad with alternating bytes until data capacity is reached
-	for (uint8_t padByte = 0xEC; bb.size() < dataCapacityBits; padByte ^= 0xEC ^ 0x11)
-		bb.appendBits(padByte, 8);
-	
-	// Pack bits into bytes in big endian
-	vector<uint8_t> dataCodewords(bb.size() / 8);
-	for (size_t i = 0; i < bb.size(); i++)
-		dataCodewords.at(i >> 3) |= (bb.at(i) ? 1 : 0) << (7 - (i & 7));
 	
 	// Create the QR Code object
 	return QrCode(version, ecl, dataCodewords, mask);
@@ -331,28 +351,52 @@ QrCode::QrCode(int ver, Ecc ecl, const vector<uint8_t> &dataCodewords, int msk)
 	isFunction = vector<vector<bool> >(sz, vector<bool>(sz));
 	
 	// Compute ECC, draw modules
-	drawFunctionPatterns();
-	const vector<uint8_t> allCodewords = addEccAndInterleave(dataCodewords);
-	drawCodewords(allCodewords);
+	{
+		QRCODEGEN_STAGE(DRAWING);
+		drawFunctionPatterns();
+	}
+	vector<uint8_t> allCodewords;
+	{
+		QRCODEGEN_STAGE(ECC);
+		allCodewords = addEccAndInterleave(dataCodewords);
+	}
+	{
+		QRCODEGEN_STAGE(DRAWING);
+		drawCodewords(allCodewords);
+	}
 	
 	// Do masking
 	if (msk == -1) {  // Automatically choose best mask
 		long minPenalty = LONG_MAX;
 		for (int i = 0; i < 8; i++) {
-			applyMask(i);
-			drawFormatBits(i);
-			long penalty = getPenaltyScore();
+			{
+				QRCODEGEN_STAGE(MASKING);
+				applyMask(i);
+				drawFormatBits(i);
+			}
+			long penalty;
+			{
+				QRCODEGEN_STAGE(PENALTY);
+				penalty = getPenaltyScore();
+			}
 			if (penalty < minPenalty) {
 				msk = i;
 				minPenalty = penalty;
 			}
+			QRCODEGEN_STAGE(MASKING);
 			applyMask(i);  // Undoes the mask due to XOR
 		}
 	}
 	assert(0 <= msk && msk <= 7);
 	mask = msk;
-	applyMask(msk);  // Apply the final choice of mask
-	drawFormatBits(msk);  // Overwrite old format bits
+	{
+		QRCODEGEN_STAGE(MASKING);
+		applyMask(msk);  // Apply the final choice of mask
+	}
+	{
+		QRCODEGEN_STAGE(DRAWING);
+		drawFormatBits(msk);  // Overwrite old format bits
+	}
 	
 	isFunction.clear();
 	isFunction.shrink_to_fit();
@@ -827,4 +871,40 @@ void BitBuffer::appendBits(std::uint32_t val, int len) {
 		this->push_back(((val >> i) & 1) != 0);
 }
 
+
+
+
+#ifdef QRCODEGEN_PROFILE
+
+/*---- Class Profile ----*/
+
+const char *const Profile::STAGE_NAMES[STAGE_COUNT] = {
+	"segmenting", "bit_packing", "ecc", "drawing", "masking", "penalty",
+};
+
+std::uint32_t (*Profile::clock)() = nullptr;
+std::uint64_t Profile::total[STAGE_COUNT] = {};
+std::uint32_t Profile::calls[STAGE_COUNT] = {};
+
+
+void Profile::reset() {
+	std::fill(std::begin(total), std::end(total), 0);
+	std::fill(std::begin(calls), std::end(calls), 0);
+}
+
+
+Profile::Scope::Scope(Stage st) :
+		stage(st),
+		start(clock != nullptr ? clock() : 0) {}
+
+
+Profile::Scope::~Scope() {
+	if (clock == nullptr)
+		return;
+	total[stage] += static_cast<std::uint32_t>(clock() - start);
+	calls[stage]++;
+}
+
+#endif
+
 }
@@ -546,4 +546,52 @@ class BitBuffer final : public std::vector<bool> {
 	
 };
 
+
+
+#ifdef QRCODEGEN_PROFILE
+/* 
+ * Time spent in the stages of the encoder, accumulated over all symbols built
+ * since the last call to reset(). Only compiled in with QRCODEGEN_PROFILE defined.
+ * The unit is whatever the clock function returns (e.g. CPU cycles or nanoseconds),
+ * profiling is inactive as long as no clock is set.
+ */
+class Profile final {
+	
+	public: enum Stage {
+		SEGMENTING,   // Choosing and building the segments in encodeText() and encodeBinary()
+		BIT_PACKING,  // Version search, concatenation and padding of the data bits
+		ECC,          // Reed-Solomon blocks and interleaving
+		DRAWING,      // Function patterns, codeword placement and the final format bits
+		MASKING,      // Applying and undoing the candidate masks
+		PENALTY,      // Penalty scoring of the candidate masks
+		STAGE_COUNT
+	};
+	
+	public: static const char *const STAGE_NAMES[STAGE_COUNT];
+	
+	// Free running counter, differences are taken modulo 2^32.
+	public: static std::uint32_t (*clock)();
+	
+	public: static std::uint64_t total[STAGE_COUNT];
+	
+	public: static std::uint32_t calls[STAGE_COUNT];
+	
+	public: static void reset();
+	
+	
+	// Adds the time until the end of the scope to the given stage.
+	public: class Scope final {
+		
+		public: explicit Scope(Stage st);
+		
+		public: ~Scope();
+		
+		private: Stage stage;
+		private: std::uint32_t start;
+		
+	};
+	
+};
+#endif
+
 }
@@ -0,0 +1,248 @@
+#include "Raster.h"
+
+namespace raster {
+
+uint32_t nextCodepoint(const char *&text) {
+    constexpr uint32_t replacement = 0xFFFD;
+    const uint8_t c = *text;
+    if(c == 0)
+        return 0;
+    text++;
+    if(c < 0x80)
+        return c;
+
+    size_t follow;
+    uint32_t cp;
+    if((c & 0xE0) == 0xC0) {
+        follow = 1;
+        cp = c & 0x1F;
+    } else if((c & 0xF0) == 0xE0) {
+        follow = 2;
+        cp = c & 0x0F;
+    } else if((c & 0xF8) == 0xF0) {
+        follow = 3;
+        cp = c & 0x07;
+    } else {
+        return replacement;
+    }
+
+    for(size_t i = 0; i < follow; i++) {
+        const uint8_t n = *text;
+        if((n & 0xC0) != 0x80)
+            return replacement;
+        cp = (cp << 6) | (n & 0x3F);
+        text++;
+    }
+    return cp;
+}
+
+size_t packBits(const uint8_t *in, size_t len, uint8_t *out) {
+    constexpr size_t maxRun = 128;
+    // runs shorter than three bytes are cheaper to keep inside a literal
+    auto runLength = [&](size_t i) {
+        size_t run = 1;
+        while(i + run < len && run < maxRun && in[i + run] == in[i])
+            run++;
+        return run;
+    };
+
+    size_t o = 0;
+    size_t i = 0;
+    while(i < len) {
+        const size_t run = runLength(i);
+        if(run >= 3) {
+            out[o++] = uint8_t(1 - int(run));
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+
+        size_t lit = run;
+        while(i + lit < len && lit < maxRun && runLength(i + lit) < 3)
+            lit++;
+        out[o++] = uint8_t(lit - 1);
+        memcpy(out + o, in + i, lit);
+        o += lit;
+        i += lit;
+    }
+    return o;
+}
+
+void fillSpan(uint8_t *line, int x, int w) {
+    int x0 = std::max(x, 0);
+    const int x1 = std::min<int>(x + w, pxLine);
+    // single dots up to the next byte boundary, then whole bytes
+    for(; x0 < x1 && (x0 % 8) != 0; x0++)
+        line[x0 / 8] |= 0x80 >> (x0 % 8);
+    for(; x0 + 8 <= x1; x0 += 8)
+        line[x0 / 8] = 0xFF;
+    for(; x0 < x1; x0++)
+        line[x0 / 8] |= 0x80 >> (x0 % 8);
+}
+
+const Glyph *Font::find(uint32_t codepoint) const {
+    const Glyph *end = glyphs + glyphCount;
+    const Glyph *g = std::lower_bound(glyphs, end, codepoint, [](const Glyph &a, uint32_t cp) { return a.codepoint < cp; });
+    return (g != end && g->codepoint == codepoint) ? g : nullptr;
+}
+
+int8_t Font::kern(uint32_t left, uint32_t right) const {
+    if(kerningCount == 0 || left == 0)
+        return 0;
+    const KerningPair *end = kerning + kerningCount;
+    const KerningPair *k = std::lower_bound(kerning, end, std::make_pair(left, right), [](const KerningPair &a, const std::pair<uint32_t, uint32_t> &b) {
+        return (a.left < b.first) || (a.left == b.first && a.right < b.second);
+    });
+    return (k != end && k->left == left && k->right == right) ? k->adjust : 0;
+}
+
+size_t Font::textWidth(const char *text, size_t len, uint8_t spacing) const {
+    const char *end = text + len;
+    int width = 0;
+    uint32_t prev = 0;
+    while(text < end) {
+        const uint32_t cp = nextCodepoint(text);
+        const Glyph *g = find(cp);
+        if(g == nullptr)
+            g = find('?');
+        if(g == nullptr)
+            continue;
+        if(prev != 0)
+            width += spacing;
+        width += kern(prev, cp) + g->advance;
+        prev = cp;
+    }
+    return std::max(width, 0);
+}
+
+void Band::clear(size_t lines) {
+    height = std::min(lines, maxLines);
+    memset(buffer.data(), 0, height * lineBytes);
+}
+
+bool Band::isBlank(size_t y) const {
+    const uint8_t *l = line(y);
+    return std::all_of(l, l + lineBytes, [](uint8_t b) { return b == 0; });
+}
+
+void Band::setPixel(int x, int y, bool on) {
+    if(x < 0 || y < 0 || size_t(x) >= pxLine || size_t(y) >= height)
+        return;
+    uint8_t &b = line(y)[x / 8];
+    const uint8_t mask = 0x80 >> (x % 8);
+    b = on ? (b | mask) : (b & ~mask);
+}
+
+bool Band::getPixel(int x, int y) const {
+    if(x < 0 || y < 0 || size_t(x) >= pxLine || size_t(y) >= height)
+        return false;
+    return line(y)[x / 8] & (0x80 >> (x % 8));
+}
+
+void Band::fillRect(int x, int y, int w, int h, bool on) {
+    const int x0 = std::max(x, 0);
+    const int x1 = std::min<int>(x + w, pxLine);
+    const int y0 = std::max(y, 0);
+    const int y1 = std::min<int>(y + h, height);
+    for(int row = y0; row < y1; row++) {
+        if(on) {
+            fillSpan(line(row), x, w);
+            continue;
+        }
+        for(int col = x0; col < x1; col++)
+            setPixel(col, row, false);
+    }
+}
+
+void Band::blit(int x, int y, const uint8_t *bitmap, size_t width, size_t h, size_t stride, bool invert) {
+    for(size_t row = 0; row < h; row++) {
+        const int dy = y + int(row);
+        if(dy < 0)
+            continue;
+        if(size_t(dy) >= height)
+            break;
+        const uint8_t *src = bitmap + row * stride;
+        uint8_t *dst = line(dy);
+
+        if(x >= 0 && (x % 8) == 0 && !invert) {
+            // byte aligned, OR whole bytes into the line
+            const size_t first = x / 8;
+            const size_t count = std::min((width + 7) / 8, lineBytes - std::min(first, lineBytes));
+            for(size_t i = 0; i < count; i++) {
+                uint8_t v = src[i];
+                if((i + 1) * 8 > width)
+                    v &= uint8_t(0xFF << ((i + 1) * 8 - width));
+                dst[first + i] |= v;
+            }
+            continue;
+        }
+
+        for(size_t col = 0; col < width; col++) {
+            const bool on = src[col / 8] & (0x80 >> (col % 8));
+            if(on != invert)
+                setPixel(x + int(col), dy);
+        }
+    }
+}
+
+int Band::drawGlyph(const Font &font, int x, int y, uint32_t codepoint) {
+    const Glyph *g = font.find(codepoint);
+    if(g == nullptr)
+        g = font.find('?');
+    if(g == nullptr)
+        return 0;
+    blit(x + g->xOffset, y + g->yOffset, font.bitmap + g->offset, g->width, g->height, (g->width + 7) / 8);
+    return g->advance;
+}
+
+int Band::drawText(const Font &font, int x, int y, const char *text, size_t len, uint8_t spacing) {
+    const char *end = text + len;
+    const int baseline = y + font.ascent;
+    const int start = x;
+    uint32_t prev = 0;
+    while(text < end) {
+        const uint32_t cp = nextCodepoint(text);
+        if(prev != 0)
+            x += spacing + font.kern(prev, cp);
+        x += drawGlyph(font, x, baseline, cp);
+        prev = cp;
+    }
+    return x - start;
+}
+
+size_t wrapLine(const Font &font, const char *text, size_t maxWidth, uint8_t spacing, const char *&next) {
+    const char *p = text;
+    const char *lastBreak = nullptr;
+    int width = 0;
+    uint32_t prev = 0;
+
+    while(*p != 0 && *p != '\n') {
+        const char *cur = p;
+        const uint32_t cp = nextCodepoint(p);
+        if(cp == ' ')
+            lastBreak = cur;
+
+        const Glyph *g = font.find(cp);
+        if(g == nullptr)
+            g = font.find('?');
+        const int advance = (g ? g->advance : 0) + ((prev != 0) ? spacing + font.kern(prev, cp) : 0);
+        if(width + advance > int(maxWidth) && cp != ' ') {
+            // line is full, break at the last space or right here
+            const char *end = (lastBreak != nullptr) ? lastBreak : ((cur == text) ? p : cur);
+            next = end;
+            while(*next == ' ')
+                next++;
+            return end - text;
+        }
+        width += advance;
+        prev = cp;
+    }
+
+    next = (*p == '\n') ? p + 1 : p;
+    // trailing spaces do not count to the line
+    while(p > text && p[-1] == ' ')
+        p--;
+    return p - text;
+}
+
+} // namespace raster
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <Arduino.h>
+#include <array>
+#include <vector>
+
+namespace raster {
+
+static constexpr size_t pxLine = 384;
+static constexpr size_t lineBytes = pxLine / 8;
+
+enum class Align : uint8_t { left = 0, center, right };
+
+/**
+ * Decode the next code point of an UTF-8 string and advance the pointer.
+ * Invalid sequences are returned as U+FFFD, the terminating 0 is not consumed.
+ */
+uint32_t nextCodepoint(const char *&text);
+
+/**
+ * PackBits encode one graphic line (the printer's tiff mode).
+ * out needs room for len + (len + 127) / 128 bytes, returns the encoded length.
+ */
+size_t packBits(const uint8_t *in, size_t len, uint8_t *out);
+
+/**
+ * Set w dots of a graphic line starting at dot x, clipped to the line.
+ */
+void fillSpan(uint8_t *line, int x, int w);
+
+/**
+ * Glyph of a compiled-in bitmap font. The glyph bitmap is stored row by row,
+ * each row padded to full bytes with the MSB being the leftmost dot.
+ * The top left corner of the bitmap is at (pen + xOffset, baseline + yOffset).
+ */
+struct Glyph {
+    uint32_t codepoint;
+    uint32_t offset;
+    uint8_t width;
+    uint8_t height;
+    int8_t xOffset;
+    int8_t yOffset;
+    uint8_t advance;
+};
+
+struct KerningPair {
+    uint32_t left;
+    uint32_t right;
+    int8_t adjust;
+};
+
+/**
+ * Bitmap font as generated by tools/fontConverter.py.
+ * Glyphs and kerning pairs are sorted to allow binary searching them.
+ */
+struct Font {
+    uint8_t height;
+    uint8_t ascent;
+    uint16_t glyphCount;
+    uint16_t kerningCount;
+    const Glyph *glyphs;
+    const uint8_t *bitmap;
+    const KerningPair *kerning;
+
+    const Glyph *find(uint32_t codepoint) const;
+    int8_t kern(uint32_t left, uint32_t right) const;
+
+    /**
+     * Width in dots of the first len bytes of an UTF-8 string.
+     */
+    size_t textWidth(const char *text, size_t len, uint8_t spacing = 0) const;
+};
+
+/**
+ * Grid of dark and light modules of a 2D symbol, e.g. a Data Matrix.
+ */
+class Matrix {
+public:
+    Matrix() = default;
+    Matrix(size_t w, size_t h) : w{w}, h{h}, modules(w * h, 0) { }
+
+    size_t width() const { return w; }
+    size_t height() const { return h; }
+
+    bool getModule(int x, int y) const { return x >= 0 && y >= 0 && size_t(x) < w && size_t(y) < h && modules[y * w + x]; }
+    void setModule(size_t x, size_t y, bool dark) { modules[y * w + x] = dark; }
+
+private:
+    size_t w{0};
+    size_t h{0};
+    std::vector<uint8_t> modules;
+};
+
+/**
+ * A band of full-width graphic lines which is rendered in RAM before being
+ * sent to the printer. Only a single band needs to be resident at a time.
+ */
+class Band {
+public:
+    static constexpr size_t maxLines = 64;
+
+    explicit Band(size_t lines = maxLines) { clear(lines); }
+
+    void clear(size_t lines = maxLines);
+    size_t lines() const { return height; }
+
+    const uint8_t *line(size_t y) const { return buffer.data() + y * lineBytes; }
+    uint8_t *line(size_t y) { return buffer.data() + y * lineBytes; }
+
+    bool isBlank(size_t y) const;
+
+    void setPixel(int x, int y, bool on = true);
+    bool getPixel(int x, int y) const;
+    void fillRect(int x, int y, int w, int h, bool on = true);
+
+    /**
+     * Copy a 1bpp bitmap (rows padded to stride bytes, MSB first) into the band.
+     * Rows and columns outside of the band are clipped.
+     */
+    void blit(int x, int y, const uint8_t *bitmap, size_t width, size_t height, size_t stride, bool invert = false);
+
+    /**
+     * Draw a single glyph with its origin at x and the baseline at y.
+     * Returns the advance including kerning towards the previous code point.
+     */
+    int drawGlyph(const Font &font, int x, int y, uint32_t codepoint);
+
+    /**
+     * Draw the first len bytes of an UTF-8 string with the top of the font at y.
+     * Returns the width of the text in dots.
+     */
+    int drawText(const Font &font, int x, int y, const char *text, size_t len, uint8_t spacing = 0);
+
+private:
+    size_t height{0};
+    std::array<uint8_t, maxLines * lineBytes> buffer;
+};
+
+/**
+ * Break text into lines of at most maxWidth dots. Lines are broken at spaces if
+ * possible, single words wider than a line are split between characters.
+ * Returns the length of the next line in bytes, next points to the start of the
+ * following line (leading spaces and an explicit newline are skipped).
+ */
+size_t wrapLine(const Font &font, const char *text, size_t maxWidth, uint8_t spacing, const char *&next);
+
+} // namespace raster
@@ -0,0 +1,312 @@
+#include "ReceiptTemplate.h"
+
+#include <charconv>
+#include <cstring>
+#include <string_view>
+
+using qrcodegen::QrCode;
+
+namespace {
+
+constexpr const char *symbologyNames[] = {"code39", "itf", "ean13", "ean8", "upca", "code128"};
+
+std::string_view trim(std::string_view s) {
+    while(!s.empty() && s.front() == ' ')
+        s.remove_prefix(1);
+    while(!s.empty() && s.back() == ' ')
+        s.remove_suffix(1);
+    return s;
+}
+
+bool parseNumber(std::string_view s, long min, long max, long &value) {
+    const auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+    return ec == std::errc() && end == s.data() + s.size() && value >= min && value <= max;
+}
+
+bool parseOnOff(std::string_view s, long &value) {
+    if(s != "on" && s != "off")
+        return false;
+    value = s == "on";
+    return true;
+}
+
+} // namespace
+
+void ReceiptTemplate::Values::set(int slot, const char *value) {
+    if(slot >= 0 && size_t(slot) < maxSlots)
+        text[slot] = value;
+}
+
+void ReceiptTemplate::Values::set(int slot, long value) {
+    if(slot < 0 || size_t(slot) >= maxSlots)
+        return;
+    snprintf(numbers[slot].data(), numbers[slot].size(), "%ld", value);
+    text[slot] = numbers[slot].data();
+}
+
+void ReceiptTemplate::Values::set(int slot, double value, uint8_t decimals) {
+    if(slot < 0 || size_t(slot) >= maxSlots)
+        return;
+    snprintf(numbers[slot].data(), numbers[slot].size(), "%.*f", decimals, value);
+    text[slot] = numbers[slot].data();
+}
+
+const char *ReceiptTemplate::Values::get(int slot) const {
+    if(slot < 0 || size_t(slot) >= maxSlots || text[slot] == nullptr)
+        return "";
+    return text[slot];
+}
+
+bool ReceiptTemplate::compile(const char *description) {
+    program.clear();
+    parts.clear();
+    pool.clear();
+    slotNames.clear();
+    qrCodes.clear();
+    error = 0;
+
+    raster::Align align = raster::Align::left;
+    int itemsStart = -1;
+    size_t lineNumber = 0;
+    for(const char *line = description; *line != 0;) {
+        lineNumber++;
+        size_t len = strcspn(line, "\n");
+        const char *next = line[len] ? line + len + 1 : line + len;
+        while(len > 0 && line[len - 1] == '\r')
+            len--;
+
+        bool ok = true;
+        if(len == 0 || line[0] == '#') {
+            // blank lines only structure the description, use @feed for space
+        } else if(line[0] == '@') {
+            ok = parseDirective(line + 1, len - 1, align, itemsStart);
+        } else {
+            Text text;
+            ok = parseText(line, len, text);
+            program.push_back(TextOp{text, align});
+        }
+        if(!ok) {
+            error = lineNumber;
+            return false;
+        }
+        line = next;
+    }
+    if(itemsStart >= 0) {
+        // @items without @end
+        error = lineNumber;
+        return false;
+    }
+    return true;
+}
+
+int ReceiptTemplate::slot(const char *name) const {
+    for(size_t i = 0; i < slotNames.size(); i++)
+        if(slotNames[i] == name)
+            return i;
+    return -1;
+}
+
+bool ReceiptTemplate::parseText(const char *text, size_t len, Text &out) {
+    out.first = parts.size();
+    const char *end = text + len;
+    while(text < end) {
+        const char *open = std::find(text, end, '{');
+        if(open != text) {
+            parts.push_back(Part{uint16_t(pool.size()), uint16_t(open - text), -1});
+            pool.append(text, open - text);
+        }
+        if(open == end)
+            break;
+        const char *close = std::find(open, end, '}');
+        if(close == end)
+            return false;
+        const std::string name(open + 1, close);
+        int index = slot(name.c_str());
+        if(index < 0) {
+            if(slotNames.size() == maxSlots)
+                return false;
+            index = slotNames.size();
+            slotNames.push_back(name);
+        }
+        parts.push_back(Part{0, 0, int8_t(index)});
+        text = close + 1;
+    }
+    out.count = parts.size() - out.first;
+    return true;
+}
+
+bool ReceiptTemplate::parseDirective(const char *line, size_t len, raster::Align &align, int &itemsStart) {
+    const std::string_view directive(line, len);
+    const size_t space = directive.find(' ');
+    const std::string_view name = directive.substr(0, space);
+    const std::string_view args = (space == std::string_view::npos) ? std::string_view() : trim(directive.substr(space + 1));
+    long value;
+
+    if(name == "left" || name == "center" || name == "right") {
+        align = (name == "left") ? raster::Align::left : (name == "center") ? raster::Align::center : raster::Align::right;
+        return args.empty();
+    }
+    if(name == "bold" || name == "underline" || name == "inverse" || name == "double") {
+        if(!parseOnOff(args, value))
+            return false;
+        const Style style = (name == "bold") ? Style::bold : (name == "underline") ? Style::underline : (name == "inverse") ? Style::inverse : Style::doubleWidth;
+        program.push_back(StyleOp{style, uint8_t(value)});
+        return true;
+    }
+    if(name == "zoom" || name == "font" || name == "spacing") {
+        const long max = (name == "zoom") ? 3 : (name == "font") ? 4 : 15;
+        if(!parseNumber(args, 0, max, value))
+            return false;
+        const Style style = (name == "zoom") ? Style::zoom : (name == "font") ? Style::font : Style::spacing;
+        program.push_back(StyleOp{style, uint8_t(value)});
+        return true;
+    }
+    if(name == "columns") {
+        const size_t bar = args.find('|');
+        if(bar == std::string_view::npos)
+            return false;
+        const std::string_view left = trim(args.substr(0, bar));
+        const std::string_view right = trim(args.substr(bar + 1));
+        ColumnsOp op;
+        if(!parseText(left.data(), left.size(), op.left) || !parseText(right.data(), right.size(), op.right))
+            return false;
+        program.push_back(op);
+        return true;
+    }
+    if(name == "items") {
+        if(itemsStart >= 0 || !args.empty())
+            return false;
+        itemsStart = program.size();
+        program.push_back(ItemsOp{0});
+        return true;
+    }
+    if(name == "end") {
+        if(itemsStart < 0 || !args.empty())
+            return false;
+        std::get<ItemsOp>(program[itemsStart]).end = program.size();
+        itemsStart = -1;
+        return true;
+    }
+    if(name == "qr" || name == "barcode") {
+        const size_t split = args.find(' ');
+        if(split == std::string_view::npos)
+            return false;
+        const std::string_view option = args.substr(0, split);
+        const std::string_view payload = trim(args.substr(split + 1));
+        Text text;
+        if(!parseText(payload.data(), payload.size(), text))
+            return false;
+
+        if(name == "barcode") {
+            const auto type = std::find(std::begin(symbologyNames), std::end(symbologyNames), option);
+            if(type == std::end(symbologyNames))
+                return false;
+            program.push_back(BarcodeOp{text, raster::Symbology(type - std::begin(symbologyNames))});
+            return true;
+        }
+
+        if(option == "auto")
+            value = -1;
+        else if(!parseNumber(option, 1, 127, value))
+            return false;
+        QrOp op{text, int8_t(value), -1};
+        if(std::all_of(parts.begin() + text.first, parts.end(), [](const Part &p) { return p.slot < 0; })) {
+            // no slots, encode it once
+            try {
+                qrCodes.push_back(QrCode::encodeText(std::string(payload).c_str(), QrCode::Ecc::ECC_LOW));
+            } catch(const qrcodegen::data_too_long &) {
+                return false;
+            }
+            op.code = qrCodes.size() - 1;
+        }
+        program.push_back(op);
+        return true;
+    }
+    if(name == "feed") {
+        if(!parseNumber(args, 0, 0xFFFF, value))
+            return false;
+        program.push_back(FeedOp{uint16_t(value)});
+        return true;
+    }
+    if(name == "cut") {
+        program.push_back(CutOp{});
+        return args.empty();
+    }
+    return false;
+}
+
+size_t ReceiptTemplate::expand(const Text &text, const Values &values, char *out, size_t size) const {
+    size_t len = 0;
+    for(size_t i = text.first; i < size_t(text.first + text.count); i++) {
+        const Part &part = parts[i];
+        const char *s = (part.slot < 0) ? pool.data() + part.offset : values.get(part.slot);
+        const size_t n = std::min<size_t>((part.slot < 0) ? part.length : strlen(s), size - 1 - len);
+        memcpy(out + len, s, n);
+        len += n;
+    }
+    out[len] = 0;
+    return len;
+}
+
+void ReceiptTemplate::render(ThermalPrinter &printer, Values &values, size_t items, ItemFiller fill, void *context) const {
+    for(size_t i = 0; i < program.size(); i++) {
+        if(const ItemsOp *block = std::get_if<ItemsOp>(&program[i])) {
+            for(size_t item = 0; item < items; item++) {
+                if(fill)
+                    fill(item, values, context);
+                execute(printer, values, i + 1, block->end);
+            }
+            i = block->end - 1;
+        } else {
+            execute(printer, values, i, i + 1);
+        }
+    }
+}
+
+void ReceiptTemplate::execute(ThermalPrinter &printer, const Values &values, size_t first, size_t last) const {
+    char line[maxLineLength];
+    for(size_t i = first; i < last; i++) {
+        std::visit(
+            [&](const auto &op) {
+                using T = std::decay_t<decltype(op)>;
+                if constexpr(std::is_same_v<T, TextOp>) {
+                    expand(op.text, values, line, sizeof(line));
+                    printer.printWrapped(line, op.align);
+                } else if constexpr(std::is_same_v<T, ColumnsOp>) {
+                    char right[maxLineLength / 4];
+                    expand(op.left, values, line, sizeof(line));
+                    expand(op.right, values, right, sizeof(right));
+                    printer.printColumns(line, right);
+                } else if constexpr(std::is_same_v<T, StyleOp>) {
+                    switch(op.style) {
+                        case Style::bold: printer.setBold(op.value); break;
+                        case Style::underline: printer.setUnderline(op.value); break;
+                        case Style::inverse: printer.setInverse(op.value); break;
+                        case Style::doubleWidth: printer.setDoubleWidth(op.value); break;
+                        case Style::zoom: printer.setHeightZoom(ThermalPrinter::ZoomLevel(op.value)); break;
+                        case Style::font: printer.setFont(op.value); break;
+                        case Style::spacing: printer.setCharSpacing(op.value); break;
+                    }
+                } else if constexpr(std::is_same_v<T, QrOp>) {
+                    if(op.code >= 0) {
+                        printer.printQrCode(qrCodes[op.code], op.zoom);
+                    } else {
+                        expand(op.payload, values, line, sizeof(line));
+                        try {
+                            printer.printQrCode(line, op.zoom);
+                        } catch(const qrcodegen::data_too_long &) {
+                            // like a failed barcode, the field is left out
+                        }
+                    }
+                } else if constexpr(std::is_same_v<T, BarcodeOp>) {
+                    expand(op.payload, values, line, sizeof(line));
+                    printer.printBarcode(line, op.type);
+                } else if constexpr(std::is_same_v<T, FeedOp>) {
+                    printer.feedPixel(op.dots);
+                } else if constexpr(std::is_same_v<T, CutOp>) {
+                    printer.cutPaper();
+                }
+            },
+            program[i]);
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Barcode.h"
+#include "QrCodeGen.hpp"
+#include "Raster.h"
+#include "ThermalPrinter.h"
+#include <Arduino.h>
+#include <array>
+#include <string>
+#include <variant>
+#include <vector>
+
+/**
+ * Receipt layout that is parsed once into a program of printer calls with
+ * slots for the variable fields. render() only fills in the slots, QR codes
+ * and barcodes without slots are encoded by compile().
+ *
+ * The description has one element per line:
+ *
+ *     # comment
+ *     @center                      alignment of the following text, also @left and @right
+ *     @bold on                     also @underline, @inverse, @double (on/off), @zoom 0-3, @font n, @spacing n
+ *     ACME Store {branch}          word wrapped text line, {name} is a slot
+ *     @columns {item} | {price}    "item ....... price" line
+ *     @items                       the lines up to @end are printed once per item
+ *     @end
+ *     @qr 6 {url}                  QR code with the given module size, auto picks the largest,
+ *                                  left out if the filled in payload is too long
+ *     @barcode code128 {id}        code39, itf, ean13, ean8, upca or code128
+ *     @feed 20                     paper feed in dots
+ *     @cut
+ */
+class ReceiptTemplate {
+public:
+    static constexpr size_t maxSlots = 32;
+    static constexpr size_t maxLineLength = 256;
+
+    /**
+     * Slot values of one receipt. Text is referenced, not copied, and has to
+     * stay valid until render() returned. Numbers are formatted in place.
+     */
+    class Values {
+    public:
+        void set(int slot, const char *text);
+        void set(int slot, int value) { set(slot, long(value)); }
+        void set(int slot, long value);
+        void set(int slot, double value, uint8_t decimals = 2);
+        const char *get(int slot) const;
+        void clear() { text.fill(nullptr); }
+
+    private:
+        std::array<const char *, maxSlots> text{};
+        std::array<std::array<char, 24>, maxSlots> numbers{};
+    };
+
+    /**
+     * Called before every repetition of the @items block to set the item slots.
+     */
+    using ItemFiller = void (*)(size_t item, Values &values, void *context);
+
+    /**
+     * Parse a description, returns false on a syntax error in errorLine().
+     */
+    bool compile(const char *description);
+    size_t errorLine() const { return error; }
+
+    /**
+     * Index of a slot for Values::set(), -1 if the description has no such slot.
+     */
+    int slot(const char *name) const;
+    size_t slotCount() const { return slotNames.size(); }
+
+    void render(ThermalPrinter &printer, Values &values, size_t items = 0, ItemFiller fill = nullptr, void *context = nullptr) const;
+
+private:
+    enum class Style : uint8_t { bold, underline, inverse, doubleWidth, zoom, font, spacing };
+
+    // text of a line: a run of literal text in pool or a slot
+    struct Part {
+        uint16_t offset;
+        uint16_t length;
+        int8_t slot;
+    };
+    struct Text {
+        uint16_t first;
+        uint16_t count;
+    };
+
+    struct TextOp {
+        Text text;
+        raster::Align align;
+    };
+    struct ColumnsOp {
+        Text left, right;
+    };
+    struct StyleOp {
+        Style style;
+        uint8_t value;
+    };
+    struct QrOp {
+        Text payload;
+        int8_t zoom;
+        // index into qrCodes for a payload without slots, else -1
+        int16_t code;
+    };
+    struct BarcodeOp {
+        Text payload;
+        raster::Symbology type;
+    };
+    struct FeedOp {
+        uint16_t dots;
+    };
+    struct CutOp { };
+    struct ItemsOp {
+        // index of the op after the block
+        uint16_t end;
+    };
+    using Op = std::variant<TextOp, ColumnsOp, StyleOp, QrOp, BarcodeOp, FeedOp, CutOp, ItemsOp>;
+
+    std::vector<Op> program;
+    std::vector<Part> parts;
+    std::string pool;
+    std::vector<std::string> slotNames;
+    std::vector<qrcodegen::QrCode> qrCodes;
+    size_t error{0};
+
+    bool parseText(const char *text, size_t len, Text &out);
+    bool parseDirective(const char *line, size_t len, raster::Align &align, int &itemsStart);
+    size_t expand(const Text &text, const Values &values, char *out, size_t size) const;
+    void execute(ThermalPrinter &printer, const Values &values, size_t first, size_t last) const;
+};
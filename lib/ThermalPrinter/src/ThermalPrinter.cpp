@@ -1,6 +1,8 @@
 #include <Arduino.h>
-#include <bitset>
+#include <bit>
+#include <memory>
 
+#include "DataMatrix.h"
 #include "QrCodeGen.hpp"
 #include "ThermalPrinter.h"
 
@@ -13,6 +15,54 @@ void ThermalPrinter::begin() {
     reset();
 }
 
+ThermalPrinter::LinkSpeed ThermalPrinter::begin(BaudSetter setBaud, void *context, std::span<const uint32_t> rates) {
+    // the printer does not answer while it boots
+    const int32_t boot = printerBootTime - millis();
+    if(boot > 0)
+        delay(boot);
+
+    LinkSpeed link{};
+    for(const uint32_t baud : rates) {
+        setBaud(baud, context);
+        link = measureLink();
+        if(link.bytesPerSecond) {
+            link.baud = baud;
+            setByteTime((1000000 + link.bytesPerSecond - 1) / link.bytesPerSecond);
+            break;
+        }
+    }
+    reset();
+    return link;
+}
+
+ThermalPrinter::LinkSpeed ThermalPrinter::measureLink() {
+    LinkSpeed link{0, UINT32_MAX, 0};
+    // alternating and constant bits, a wrong rate garbles at least one of them
+    for(const uint8_t probe : {0x55, 0xAA, 0x00, 0xFF}) {
+        const int32_t t = echoLatency(probe);
+        if(t < 0)
+            return {};
+        link.roundTrip = std::min<uint32_t>(link.roundTrip, t);
+    }
+
+    // the burst takes one round trip plus the time the printer needs for the others
+    const auto pattern = [](size_t i) { return uint8_t(0x3C + i * 37); };
+    const uint32_t start = micros();
+    for(size_t i = 0; i < linkTestEchoes; i++) {
+        output.write(commandChar);
+        output.write(to_underlying(cmd::serialEcho));
+        output.write(pattern(i));
+    }
+    output.flush();
+    for(size_t i = 0; i < linkTestEchoes; i++)
+        if(readResponse(defaultStatusTimeout) != pattern(i))
+            return {};
+    const uint32_t total = micros() - start;
+    const uint32_t elapsed = (total > link.roundTrip) ? total - link.roundTrip : 1;
+    link.bytesPerSecond = uint64_t(3 * (linkTestEchoes - 1)) * 1000000 / elapsed;
+    return link;
+}
+
 void ThermalPrinter::reset() {
     writeCmd(false, cmd::reset);
     timeoutWait();
@@ -37,8 +87,11 @@ void ThermalPrinter::reset() {
     fontIndex = 0;
     charSpacing = 0;
     compression = GraphicEncoding::uncompressed;
+    activeEncoding.reset();
     heightZoom = ZoomLevel::single;
     doubleWidth = false;
+    printerStyle = TextStyle{};
+    column = 0;
 
     barcodeHeight = 80;
     barcodeWithText = true;
@@ -46,68 +99,462 @@ void ThermalPrinter::reset() {
 
 void ThermalPrinter::tab() { write('\t'); }
 
+void ThermalPrinter::advanceColumn(uint8_t c) {
+    if(c == '\n') {
+        column = 0;
+    } else if(c == '\t') {
+        column = (column / tabWidth + 1) * tabWidth;
+    } else {
+        // a character that does not fit starts a new line on the printer
+        const uint16_t advance = charAdvance();
+        column = (column + advance > pxLine) ? advance : column + advance;
+    }
+}
+
+const char *ThermalPrinter::wrapLine(const char *text, size_t columns, size_t &len) const {
+    const size_t end = strcspn(text, "\n");
+    if(end <= columns) {
+        len = end;
+        return text[end] ? text + end + 1 : text + end;
+    }
+    // break at the last space that fits, a longer word is split
+    size_t brk = columns;
+    while(brk > 0 && text[brk] != ' ')
+        brk--;
+    len = brk ? brk : columns;
+    const char *next = text + len;
+    while(len > 0 && text[len - 1] == ' ')
+        len--;
+    while(*next == ' ')
+        next++;
+    return next;
+}
+
+void ThermalPrinter::printLine(const char *text, size_t len, raster::Align align) {
+    char line[pxLine / charWidth + 1];
+    len = std::min(len, sizeof(line) - 1);
+    const size_t width = len * charAdvance();
+    if(align != raster::Align::left && width < pxLine)
+        setAbsoluteCursor(uint16_t(align == raster::Align::center ? (pxLine - width) / 2 : pxLine - width));
+    memcpy(line, text, len);
+    line[len] = '\n';
+    write(reinterpret_cast<const uint8_t *>(line), len + 1);
+}
+
+void ThermalPrinter::printWrapped(const char *text, raster::Align align) {
+    if(column)
+        write('\n');
+    const size_t columns = getColumns();
+    while(*text) {
+        size_t len;
+        const char *next = wrapLine(text, columns, len);
+        printLine(text, len, align);
+        text = next;
+    }
+}
+
+void ThermalPrinter::printColumns(const char *left, const char *right, char fill) {
+    if(column)
+        write('\n');
+    const size_t columns = getColumns();
+    const size_t rightLen = std::min(strlen(right), columns);
+    size_t len = 0;
+    for(;;) {
+        const char *next = wrapLine(left, columns, len);
+        if(!*next)
+            break;
+        printLine(left, len, raster::Align::left);
+        left = next;
+    }
+    // keep at least one fill character between the columns
+    if(len && len + 1 + rightLen > columns) {
+        printLine(left, len, raster::Align::left);
+        len = 0;
+    }
+    char line[pxLine / charWidth + 1];
+    memcpy(line, left, len);
+    memset(line + len, fill, columns - rightLen - len);
+    memcpy(line + columns - rightLen, right, rightLen);
+    printLine(line, columns, raster::Align::left);
+}
+
+bool ThermalPrinter::printTextSuperPosition(const char *text) {
+    const size_t len = strlen(text);
+    if(len > getColumns())
+        return false;
+    if(column)
+        write('\n');
+    // back to the top of the previous line, assuming it had the current height
+    const uint16_t height = charHeight << to_underlying(heightZoom);
+    pendingFeed -= height;
+    if(labelMode)
+        labelPos = labelPos >= height ? labelPos - height : 0;
+    printLine(text, len, raster::Align::left);
+    return true;
+}
+
 void ThermalPrinter::timeoutSet(uint32_t timeout) {
-    if(useTimeout)
+    // like resumeTime, a later call replaces the wait, it only counts once waited for
+    if(recording)
+        recordedWait = timeout;
+    else if(useTimeout)
         resumeTime = micros() + timeout;
 }
 
 void ThermalPrinter::timeoutWait() {
+    if(recording) {
+        if(recordedWait) {
+            recording->pauses.push_back({uint32_t(recording->data.size()), recordedWait});
+            recording->duration += recordedWait;
+        }
+        recordedWait = 0;
+        return;
+    }
+    // a status request must not end up inside a passed through command
+    if(pacing == Pacing::status && !raw.escape && raw.argCount == raw.received && raw.payload == 0 && waitForBuffer())
+        return;
+#ifdef THERMALPRINTER_INSTRUMENT
+    const uint32_t start = micros();
+    while(int32_t(micros() - resumeTime) < 0) {
+        const uint32_t y = micros();
+        yield();
+        stats.yieldUs += micros() - y;
+        stats.yieldCount++;
+    }
+    stats.waitUs += micros() - start;
+#else
     while(int32_t(micros() - resumeTime) < 0)
         yield();
+#endif
+}
+
+bool ThermalPrinter::waitForBuffer() {
+    // after an unanswered request every command is paced by the timing model
+    if(unconfirmed < statusInterval)
+        return !statusLost;
+    unconfirmed = 0;
+    const uint32_t start = micros();
+    for(;;) {
+        const Status s = getStatus();
+        // a buffer that stays full, e.g. without paper, must not hang the caller
+        statusLost = !s.valid || (s.bufferFull && micros() - start >= bufferFullTimeout);
+        if(statusLost)
+            return false;
+        if(!s.bufferFull) {
+            // the printer keeps up, forget the modelled backlog
+            resumeTime = micros();
+            return true;
+        }
+        const uint32_t until = micros() + statusPollTime;
+        while(int32_t(micros() - until) < 0)
+            yield();
+    }
+}
+
+int ThermalPrinter::readResponse(uint32_t timeoutUs) {
+    const uint32_t start = micros();
+    while(output.available() <= 0) {
+        if(micros() - start >= timeoutUs)
+            return -1;
+        yield();
+    }
+    return output.read();
+}
+
+void ThermalPrinter::discardInput() {
+    // stale answers of earlier requests
+    while(output.available() > 0)
+        output.read();
+}
+
+ThermalPrinter::Status ThermalPrinter::getStatus(uint32_t timeoutUs) {
+    discardInput();
+    // no writeCmd(), a query must not touch the pacing of the command stream
+    const uint32_t start = traceStart();
+    output.write(commandChar);
+    output.write(to_underlying(cmd::getStatus));
+    output.flush();
+    traceCommand(to_underlying(cmd::getStatus), 2, start);
+
+    Status s;
+    const int flags = readResponse(timeoutUs);
+    if(flags < 0)
+        return s;
+    s.valid = true;
+    s.paper = !(flags & statusPaperOut);
+    s.busy = flags & statusBusy;
+    s.bufferFull = flags & statusBufferFull;
+    s.overheated = flags & statusOverheated;
+    if(flags & statusExtended) {
+        const int fill = readResponse(timeoutUs);
+        const int temperature = readResponse(timeoutUs);
+        if(fill >= 0 && temperature >= 0) {
+            s.bufferFill = fill;
+            s.temperature = int8_t(temperature);
+        }
+    }
+    return s;
+}
+
+int32_t ThermalPrinter::echoLatency(uint8_t probe, uint32_t timeoutUs) {
+    discardInput();
+    const uint32_t start = micros();
+    output.write(commandChar);
+    output.write(to_underlying(cmd::serialEcho));
+    output.write(probe);
+    output.flush();
+    traceCommand(to_underlying(cmd::serialEcho), 3, start);
+
+    for(;;) {
+        const uint32_t elapsed = micros() - start;
+        if(elapsed >= timeoutUs)
+            return -1;
+        const int c = readResponse(timeoutUs - elapsed);
+        if(c < 0)
+            return -1;
+        if(c == probe)
+            return micros() - start;
+    }
+}
+
+bool ThermalPrinter::uploadBatch(const Batch &batch) {
+    if(recording || batch.data.empty() || batch.data.size() > batchCapacity)
+        return false;
+    // a length of 0 is the run command
+    const uint16_t len = batch.data.size();
+    writeCmd(true, cmd::loadBatchfile, (len >> 8) & 0xFF, len & 0xFF);
+    put(batch.data.data(), len);
+    unconfirmed += len;
+    timeoutSet(len * byteTime);
+    batchDuration = batch.duration;
+    return true;
+}
+
+bool ThermalPrinter::runBatch() {
+    if(!batchDuration)
+        return false;
+    flushFeed();
+    writeCmd(true, cmd::loadBatchfile, 0, 0);
+    timeoutSet(2 * byteTime + *batchDuration);
+    // the batch may have switched the encoding and the text style on the printer
+    forgetPrinterState();
+    return true;
+}
+
+uint32_t ThermalPrinter::lineTime(size_t dots) const {
+    // the printer splits a dense line into several strobes, each costs about one feed step
+    const size_t strobes = (heatBudget == 0 || dots == 0) ? 1 : (dots + heatBudget - 1) / heatBudget;
+    return strobes * dotFeedTime;
+}
+
+size_t ThermalPrinter::countDots(const uint8_t *data, size_t len, GraphicEncoding encoding) {
+    size_t dots = 0;
+    if(encoding == GraphicEncoding::tiff) {
+        // walk the PackBits stream without unpacking it
+        for(size_t i = 0; i < len;) {
+            const int8_t n = static_cast<int8_t>(data[i++]);
+            if(n >= 0) {
+                for(size_t j = 0; j <= size_t(n) && i < len; j++)
+                    dots += std::popcount(data[i++]);
+            } else if(n != -128 && i < len) {
+                dots += std::popcount(data[i++]) * (1 - n);
+            }
+        }
+    } else {
+        for(size_t i = 0; i < len; i++)
+            dots += std::popcount(data[i]);
+    }
+    return dots;
+}
+
+void ThermalPrinter::sendGraphicLine(const uint8_t *data, size_t len, size_t dots) {
+    flushFeed();
+    advanceLabel(1);
+    column = 0;
+    writeCmd(true, cmd::printGraphicLine, len);
+    const uint32_t start = traceStart();
+    put(data, len);
+    traceCommand(to_underlying(cmd::printGraphicLine), len, start);
+    unconfirmed += len;
+#ifdef THERMALPRINTER_INSTRUMENT
+    stats.graphicLines++;
+#endif
+    timeoutSet(len * byteTime + lineTime(dots));
 }
 
 size_t ThermalPrinter::write(uint8_t c) {
     // strip carriage return
     if(c != '\r') {
+        flushStyle();
+        flushFeed();
         timeoutWait();
-        output.write(c);
+        const uint32_t start = traceStart();
+        put(c);
+        traceCommand(instrumentation::textCmd, 1, start);
+        unconfirmed++;
+        advanceColumn(c);
         uint32_t delay = byteTime;
-        if(c == '\n')
-            delay += to_underlying(heightZoom) * 32 * dotFeedTime;
+        if(c == '\n') {
+            delay += newlineTime(heightZoom);
+            advanceLabel(charHeight << to_underlying(heightZoom));
+        }
         timeoutSet(delay);
     }
     return 1;
 }
 
-void ThermalPrinter::setBold(bool on) {
-    bold = on;
-    writeCmd(true, cmd::bold, (on) ? '1' : '0');
+size_t ThermalPrinter::write(const uint8_t *buffer, size_t size) {
+    flushStyle();
+    flushFeed();
+    const uint8_t *end = buffer + size;
+    for(const uint8_t *run = buffer; run < end;) {
+        // a run ends after a newline or before a carriage return, which is stripped
+        const uint8_t *stop = run;
+        while(stop < end && *stop != '\r' && *stop != '\n')
+            stop++;
+        const bool newline = stop < end && *stop == '\n';
+        const size_t len = stop - run + newline;
+        if(len) {
+            timeoutWait();
+            const uint32_t start = traceStart();
+            put(run, len);
+            traceCommand(instrumentation::textCmd, len, start);
+            unconfirmed += len;
+            for(size_t i = 0; i < len; i++)
+                advanceColumn(run[i]);
+            uint32_t delay = len * byteTime;
+            if(newline) {
+                delay += newlineTime(heightZoom);
+                advanceLabel(charHeight << to_underlying(heightZoom));
+            }
+            timeoutSet(delay);
+        }
+        run += len + (stop < end && *stop == '\r');
+    }
+    return size;
 }
 
-void ThermalPrinter::setUnderline(bool on) {
-    underline = on;
-    writeCmd(true, cmd::underline, (on) ? '1' : '0');
+void ThermalPrinter::writeRaw(const uint8_t *data, size_t len) {
+    if(len == 0)
+        return;
+    flushFeed();
+    timeoutWait();
+    put(data, len);
+    unconfirmed += len;
+    uint32_t mechanical = 0;
+    for(size_t i = 0; i < len; i++)
+        mechanical += rawTime(data[i]);
+    timeoutSet(len * byteTime + mechanical);
+    // the stream may have changed anything
+    forgetPrinterState();
+    column = 0;
 }
 
-void ThermalPrinter::setInverse(bool on) {
-    inverse = on;
-    writeCmd(true, cmd::invert, (on) ? '1' : '0');
+constexpr uint8_t ThermalPrinter::rawArgCount(uint8_t c) {
+    switch(c) {
+        case 'b': return 7;
+        case 'e':
+        case 'F':
+        case 'l':
+        case 'N':
+        case 'o':
+        case 'R':
+        case 's':
+        case '[':
+        case '\\': return 2;
+        case 'D':
+        case 'g':
+        case 'H':
+        case 'I':
+        case 'J':
+        case 'L':
+        case 'M':
+        case 'm':
+        case 'n':
+        case 'P':
+        case 'p':
+        case 'r':
+        case 'S':
+        case 'W':
+        case 'Y': return 1;
+        default: return 0;
+    }
 }
 
-void ThermalPrinter::setUpsideDown(bool on) {
-    upsideDown = on;
-    writeCmd(true, cmd::setUpsideDown, (on) ? '1' : '0');
-}
+uint32_t ThermalPrinter::rawTime(uint8_t c) {
+    if(raw.payload) {
+        if(raw.cmd == to_underlying(cmd::printGraphicLine))
+            raw.dots += std::popcount(c);
+        // the dots of a compressed line are only estimated from its bytes
+        if(--raw.payload == 0 && raw.cmd == to_underlying(cmd::printGraphicLine))
+            return lineTime(raw.dots);
+        return 0;
+    }
+    if(raw.argCount != raw.received) {
+        raw.args[raw.received++] = c;
+        if(raw.argCount != raw.received)
+            return 0;
+    } else if(raw.escape) {
+        raw = RawCommand{c, {}, rawArgCount(c), 0, false, 0, 0};
+        if(raw.argCount)
+            return 0;
+    } else {
+        raw.escape = c == commandChar;
+        return (c == '\n') ? newlineTime(rawZoom) : 0;
+    }
 
-void ThermalPrinter::setHeightZoom(ZoomLevel level) {
-    heightZoom = level;
-    const uint8_t l = to_underlying(level);
-    writeCmd(true, cmd::setCharHeight, l);
+    // complete command
+    const uint16_t arg16 = (raw.args[0] << 8) | raw.args[1];
+    switch(raw.cmd) {
+        case static_cast<uint8_t>(cmd::printGraphicLine): raw.payload = raw.args[0]; return raw.payload ? 0 : lineTime(0);
+        case static_cast<uint8_t>(cmd::printBarcode): raw.payload = raw.args[6]; return ((raw.args[4] << 8) | raw.args[5]) * dotFeedTime;
+        case static_cast<uint8_t>(cmd::loadBatchfile): raw.payload = arg16; return 0;
+        case static_cast<uint8_t>(cmd::paperFeed):
+        case static_cast<uint8_t>(cmd::reverseFeed): return arg16 * dotFeedTime;
+        case static_cast<uint8_t>(cmd::cutPaper): return cutTime;
+        case static_cast<uint8_t>(cmd::setCharHeight): rawZoom = ZoomLevel(std::min<uint8_t>(raw.args[0], 3)); return 0;
+        default: return 0;
+    }
 }
 
-void ThermalPrinter::setDoubleWidth(bool on) {
-    doubleWidth = on;
-    writeCmd(true, cmd::doubleWidth, (on) ? '1' : '0');
-}
+void ThermalPrinter::setBold(bool on) { bold = on; }
 
-void ThermalPrinter::setFont(uint8_t f) {
-    fontIndex = std::min<uint8_t>(f, 4);
-    writeCmd(true, cmd::setCharSet, fontIndex);
-}
+void ThermalPrinter::setUnderline(bool on) { underline = on; }
+
+void ThermalPrinter::setInverse(bool on) { inverse = on; }
+
+void ThermalPrinter::setUpsideDown(bool on) { upsideDown = on; }
+
+void ThermalPrinter::setHeightZoom(ZoomLevel level) { heightZoom = level; }
+
+void ThermalPrinter::setDoubleWidth(bool on) { doubleWidth = on; }
 
-void ThermalPrinter::setCharSpacing(int spacing) {
-    charSpacing = clamp<uint8_t>(spacing, 0, 15);
-    writeCmd(true, cmd::setHorizontalSpace, charSpacing);
+void ThermalPrinter::setFont(uint8_t f) { fontIndex = std::min<uint8_t>(f, 4); }
+
+void ThermalPrinter::setCharSpacing(int spacing) { charSpacing = clamp<uint8_t>(spacing, 0, 15); }
+
+void ThermalPrinter::flushStyle() {
+    const TextStyle wanted{bold, underline, inverse, upsideDown, heightZoom, doubleWidth, fontIndex, charSpacing};
+    // an unknown printer style, e.g. after a batch, is sent completely
+    auto changed = [&](auto TextStyle::*field) { return !printerStyle || (*printerStyle).*field != wanted.*field; };
+
+    if(changed(&TextStyle::bold))
+        writeCmd(true, cmd::bold, (bold) ? '1' : '0');
+    if(changed(&TextStyle::underline))
+        writeCmd(true, cmd::underline, (underline) ? '1' : '0');
+    if(changed(&TextStyle::inverse))
+        writeCmd(true, cmd::invert, (inverse) ? '1' : '0');
+    if(changed(&TextStyle::upsideDown))
+        writeCmd(true, cmd::setUpsideDown, (upsideDown) ? '1' : '0');
+    if(changed(&TextStyle::heightZoom))
+        writeCmd(true, cmd::setCharHeight, to_underlying(heightZoom));
+    if(changed(&TextStyle::doubleWidth))
+        writeCmd(true, cmd::doubleWidth, (doubleWidth) ? '1' : '0');
+    if(changed(&TextStyle::fontIndex))
+        writeCmd(true, cmd::setCharSet, fontIndex);
+    if(changed(&TextStyle::charSpacing))
+        writeCmd(true, cmd::setHorizontalSpace, charSpacing);
+    printerStyle = wanted;
 }
 
 void ThermalPrinter::feed(uint8_t lines) {
@@ -116,7 +563,71 @@ void ThermalPrinter::feed(uint8_t lines) {
     }
 }
 
-void ThermalPrinter::feedPixel(uint16_t px) { writeCmd(true, cmd::paperFeed, (px >> 8) & 0xFF, px & 0xFF); }
+void ThermalPrinter::feedPixel(uint16_t px) {
+    if(labelMode) {
+        pendingFeed += px;
+        advanceLabel(px);
+        return;
+    }
+    writeCmd(true, cmd::paperFeed, (px >> 8) & 0xFF, px & 0xFF);
+    timeoutSet(2 * byteTime + px * dotFeedTime);
+    column = 0;
+}
+
+void ThermalPrinter::beginLabels(uint16_t pageLength, uint16_t startOffset, bool gapSync) {
+    writeCmd(true, cmd::setPageLenght, (pageLength >> 8) & 0xFF, pageLength & 0xFF);
+    writeCmd(true, cmd::setPageStart, (startOffset >> 8) & 0xFF, startOffset & 0xFF);
+    writeCmd(true, cmd::setLightBarrier, gapSync ? 1 : 0);
+    labelMode = true;
+    labelLength = pageLength;
+    labelPos = 0;
+}
+
+void ThermalPrinter::endLabels(uint16_t tearOffset) {
+    nextLabel();
+    pendingFeed += tearOffset;
+    flushFeed();
+    labelMode = false;
+    // pulled back right before the next output
+    pendingFeed = -int32_t(tearOffset);
+}
+
+void ThermalPrinter::nextLabel() {
+    if(labelPos == 0)
+        return;
+    pendingFeed += labelLength - labelPos;
+    labelPos = 0;
+}
+
+void ThermalPrinter::setLabelPosition(uint16_t y) {
+    pendingFeed += int32_t(y) - labelPos;
+    labelPos = y;
+}
+
+void ThermalPrinter::advanceLabel(uint16_t dots) {
+    if(!labelMode)
+        return;
+    labelPos += dots;
+    if(labelLength)
+        labelPos %= labelLength;
+}
+
+void ThermalPrinter::flushFeed() {
+    if(pendingFeed == 0)
+        return;
+    const int32_t feed = pendingFeed;
+    pendingFeed = 0;
+    const uint16_t px = std::min<uint32_t>(std::abs(feed), 0xFFFF);
+    writeCmd(true, feed > 0 ? cmd::paperFeed : cmd::reverseFeed, (px >> 8) & 0xFF, px & 0xFF);
+    timeoutSet(2 * byteTime + px * dotFeedTime);
+    column = 0;
+}
+
+void ThermalPrinter::cutPaper() {
+    flushFeed();
+    writeCmd(true, cmd::cutPaper);
+    timeoutSet(cutTime);
+}
 
 void ThermalPrinter::printBarcode(const char *text, BarcodeType type) {
     char cType = to_underlying(type);
@@ -126,18 +637,55 @@ void ThermalPrinter::printBarcode(const char *text, BarcodeType type) {
     const uint16_t left = (pxLine - width) / 2;
 
     // print barcode
+    flushStyle();
+    flushFeed();
+    advanceLabel(barcodeHeight);
     writeCmd(true, cmd::printBarcode, cType, size, (left >> 8) & 0xFF, left & 0xFF, (barcodeHeight >> 8) & 0xFF, barcodeHeight & 0xFF, sLen);
-    Print::print(text);
+    // the text is part of the command, no wait or status poll may split it
+    put(reinterpret_cast<const uint8_t *>(text), sLen);
+    unconfirmed += sLen;
+    timeoutSet((7 + sLen) * byteTime);
 
     if(barcodeWithText) {
-        const uint16_t textOffset = (pxLine - sLen * 16) / 2;
+        const uint16_t textOffset = (pxLine - std::min<size_t>(sLen * charAdvance(), pxLine)) / 2;
         setAbsoluteCursor(textOffset);
         Print::print(text);
     }
     timeoutSet((barcodeHeight + 40 * dotPrintTime));
 }
 
-void ThermalPrinter::setAbsoluteCursor(uint16_t pxPos) { writeCmd(true, cmd::setAbsoluteCursorPos, (pxPos >> 8) & 0xFF, pxPos & 0xFF); }
+bool ThermalPrinter::printBarcode(const char *text, raster::Symbology type) {
+    raster::Barcode code;
+    if(!code.encode(type, text))
+        return false;
+    const uint8_t module = code.fitModuleWidth(pxLine);
+    if(module == 0)
+        return false;
+
+    // every line of the symbol is the same, so it is packed only once
+    uint8_t line[raster::lineBytes] = {0};
+    uint8_t packed[raster::lineBytes + 2];
+    code.draw(line, (pxLine - code.modules() * module) / 2, module);
+    const size_t len = packLine(line, packed);
+    const size_t dots = countDots(line, sizeof(line), GraphicEncoding::uncompressed);
+
+    selectGraphicEncoding(GraphicEncoding::tiff);
+    for(size_t i = 0; i < barcodeHeight; i++)
+        sendGraphicLine(packed, len, dots);
+
+    if(barcodeWithText) {
+        const uint16_t textOffset = (pxLine - std::min<size_t>(strlen(code.text()) * charAdvance(), pxLine)) / 2;
+        setAbsoluteCursor(textOffset);
+        Print::print(code.text());
+        write('\n');
+    }
+    return true;
+}
+
+void ThermalPrinter::setAbsoluteCursor(uint16_t pxPos) {
+    writeCmd(true, cmd::setAbsoluteCursorPos, (pxPos >> 8) & 0xFF, pxPos & 0xFF);
+    column = pxPos;
+}
 
 std::pair<size_t, size_t> ThermalPrinter::getMaxSizeCode(BarcodeType t, size_t chars) {
     constexpr std::array<std::pair<uint8_t, uint8_t>, 8> sizes = {{{2, 5}, {2, 6}, {3, 7}, {4, 9}, {5, 12}, {6, 14}, {7, 16}, {8, 18}}};
@@ -176,59 +724,65 @@ std::pair<size_t, size_t> ThermalPrinter::getMaxSizeCode(BarcodeType t, size_t c
 bool ThermalPrinter::printQrCode(const char *text, int zoom) {
     constexpr QrCode::Ecc eccLvl = QrCode::Ecc::ECC_LOW;
 
+#ifdef THERMALPRINTER_INSTRUMENT
+    const uint32_t start = micros();
     const QrCode qr = QrCode::encodeText(text, eccLvl);
+    const uint32_t encodeUs = micros() - start;
+    stats.qrCount++;
+    stats.qrEncodeUs += encodeUs;
+    stats.qrEncodeMaxUs = std::max(stats.qrEncodeMaxUs, encodeUs);
+#else
+    const QrCode qr = QrCode::encodeText(text, eccLvl);
+#endif
     return printQrCode(qr, zoom);
 }
 
 bool ThermalPrinter::printQrCode(const qrcodegen::QrCode &qrCode, int zoom) {
     constexpr uint8_t border = 4;
     const size_t qrSize = qrCode.getSize();
-    size_t lineCount = zoom;
+    return printModules(qrSize, qrSize, zoom, border, [&](int x, int y) { return qrCode.getModule(x, y); });
+}
+
+bool ThermalPrinter::printDataMatrix(const char *text, int zoom) {
+    const raster::Matrix m = raster::DataMatrix::encodeText(text);
+    if(m.width() == 0)
+        return false;
+    return printMatrix(m, zoom);
+}
+
+bool ThermalPrinter::printMatrix(const raster::Matrix &matrix, int zoom, uint8_t border) {
+    return printModules(matrix.width(), matrix.height(), zoom, border, [&](int x, int y) { return matrix.getModule(x, y); });
+}
 
+template <typename F> bool ThermalPrinter::printModules(size_t width, size_t height, int zoom, uint8_t border, F getModule) {
+    const size_t modules = width + 2 * border;
     if(zoom == -1) {
-        lineCount = pxLine / (2 * border + qrSize);
-    } else if((2 * border + qrSize) * zoom > pxLine) {
+        zoom = pxLine / modules;
+    } else if(zoom == 0) {
+        // like the Compositor
+        zoom = 1;
+    }
+    if(zoom <= 0 || modules * zoom > pxLine) {
         return false;
     }
 
-    const int pxOffset = ((pxLine - (2 * border + qrSize) * zoom) / 2) - 1;
+    const int pxOffset = (pxLine - modules * zoom) / 2;
 
     feed();
-    writeCmd(true, cmd::graphicMode, 0);
-    for(int y = -border; y < int(qrSize + border); y++) {
+    selectGraphicEncoding(GraphicEncoding::uncompressed);
+    for(int y = -border; y < int(height + border); y++) {
         // here we prints a module row
-        std::bitset<pxLine> rowBits(0);
-        constexpr std::bitset<pxLine> mask(0xFF);
-        int byteDelay = 0;
-        uint8_t row[pxLine / 8];
-
-        for(size_t i = 0; i < qrSize + 2 * border; i++) {
-            if(qrCode.getModule(i - border, y)) {
-                const int firstIdx = pxOffset + (i * zoom);
-                byteDelay++;
-                for(int j = firstIdx; j < firstIdx + zoom; j++) {
-                    rowBits.set(j);
-                }
-            }
+        uint8_t row[raster::lineBytes] = {0};
+        for(size_t i = 0; i < width; i++) {
+            if(getModule(i, y))
+                raster::fillSpan(row, pxOffset + (border + i) * zoom, zoom);
         }
 
-        constexpr uint8_t lookup[16] = {
-            0x0, 0x8, 0x4, 0xc, 0x2, 0xa, 0x6, 0xe, 0x1, 0x9, 0x5, 0xd, 0x3, 0xb, 0x7, 0xf,
-        };
-        for(size_t i = 0; i < sizeof(row); i++) {
-            const auto val = static_cast<uint8_t>(((rowBits >> (8 * i)) & mask).to_ulong());
-            row[i] = (lookup[val & 0x0F] << 4) | lookup[val >> 4];
-        }
-
-        for(size_t i = 0; i < lineCount; i++) {
-            writeCmd(false, cmd::printGraphicLine, sizeof(row));
-            delayMicroseconds(10);
-            output.write(row, sizeof(row));
-            output.flush();
-            delayMicroseconds(byteDelay * 32 * byteTime);
-        }
-        delay(100);
+        const size_t dots = countDots(row, sizeof(row), GraphicEncoding::uncompressed);
+        for(int i = 0; i < zoom; i++)
+            sendGraphicLine(row, sizeof(row), dots);
     }
+    timeoutWait();
     return true;
 }
 
@@ -236,20 +790,116 @@ void ThermalPrinter::setGraphicEncoding(GraphicEncoding compression) {
     this->compression = compression;
     const uint8_t val = to_underlying(compression);
     writeCmd(true, cmd::graphicMode, val);
+    activeEncoding = compression;
+}
+
+void ThermalPrinter::selectGraphicEncoding(GraphicEncoding encoding) {
+    if(activeEncoding == encoding)
+        return;
+    writeCmd(true, cmd::graphicMode, to_underlying(encoding));
+    activeEncoding = encoding;
 }
 
 void ThermalPrinter::printBitmap(size_t width, size_t height, const uint8_t *bitmap) {
     constexpr size_t maxRowBytes = 48;
     const size_t rowBytes = std::min(maxRowBytes, (width + 7) / 8);
-    writeCmd(true, cmd::graphicMode, to_underlying(GraphicEncoding::uncompressed));
+    selectGraphicEncoding(GraphicEncoding::uncompressed);
 
+    uint8_t row[maxRowBytes] = {0};
     for(size_t i = 0; i < height; i++) {
-        writeCmd(false, cmd::printGraphicLine, maxRowBytes);
-        Print::write(bitmap + i * rowBytes, rowBytes);
-        // print remaining bytes until the end of the line
-        for(size_t j = rowBytes; j < maxRowBytes; j++)
-            Print::write(uint8_t(0x00));
-        timeoutWait();
-        // move head to the next line
+        // remaining bytes until the end of the line stay blank
+        memcpy(row, bitmap + i * rowBytes, rowBytes);
+        sendGraphicLine(row, maxRowBytes, countDots(row, rowBytes, GraphicEncoding::uncompressed));
+    }
+    timeoutWait();
+}
+
+size_t ThermalPrinter::packLine(const uint8_t *line, uint8_t *packed) {
+    [[maybe_unused]] const uint32_t start = traceStart();
+    const size_t len = raster::packBits(line, raster::lineBytes, packed);
+#ifdef THERMALPRINTER_INSTRUMENT
+    stats.compressUs += micros() - start;
+#endif
+    return len;
+}
+
+void ThermalPrinter::printBand(const raster::Band &band) {
+    uint8_t packed[raster::lineBytes + 2];
+    uint16_t blank = 0;
+    selectGraphicEncoding(GraphicEncoding::tiff);
+    for(size_t y = 0; y < band.lines(); y++) {
+        // empty lines are merged into a single paper feed
+        if(band.isBlank(y)) {
+            blank++;
+            continue;
+        }
+        if(blank) {
+            feedPixel(blank);
+            blank = 0;
+        }
+        const uint8_t *line = band.line(y);
+        const size_t len = packLine(line, packed);
+        sendGraphicLine(packed, len, countDots(line, raster::lineBytes, GraphicEncoding::uncompressed));
+    }
+    if(blank)
+        feedPixel(blank);
+}
+
+void ThermalPrinter::printText(const raster::Font &font, const char *text, raster::Align align) { printText(font, text, text + strlen(text), align); }
+
+void ThermalPrinter::printText(const raster::Font &font, const char *text, const char *end, raster::Align align) {
+    // a band is too large for the stack, keep it on the heap for the whole text
+    auto band = std::make_unique<raster::Band>(font.height);
+    while(text < end) {
+        const char *next;
+        const size_t len = raster::wrapLine(font, text, pxLine, charSpacing, next);
+        const size_t width = font.textWidth(text, len, charSpacing);
+
+        // a line wider than the paper starts at the left edge
+        const size_t slack = pxLine - std::min<size_t>(width, pxLine);
+        int x = 0;
+        if(align == raster::Align::center)
+            x = slack / 2;
+        else if(align == raster::Align::right)
+            x = slack;
+
+        band->clear(font.height);
+        band->drawText(font, x, 0, text, len, charSpacing);
+        printBand(*band);
+        text = next;
+    }
+}
+
+void ThermalPrinter::printUtf8(const char *text) {
+    uint8_t chunk[32];
+    while(*text) {
+        const char *lineEnd = text + strcspn(text, "\n");
+        const char *next = *lineEnd ? lineEnd + 1 : lineEnd;
+
+        bool encodable = true;
+        if(fallbackFont) {
+            for(const char *p = text; p < lineEnd && encodable;)
+                encodable = codepage::encode(codePage, raster::nextCodepoint(p)) != 0;
+        }
+        if(!encodable) {
+            printText(*fallbackFont, text, lineEnd, raster::Align::left);
+            text = next;
+            continue;
+        }
+
+        size_t len = 0;
+        for(const char *p = text; p < lineEnd;) {
+            const uint8_t c = codepage::encode(codePage, raster::nextCodepoint(p));
+            chunk[len++] = c ? c : '?';
+            if(len == sizeof(chunk)) {
+                write(chunk, len);
+                len = 0;
+            }
+        }
+        if(*lineEnd)
+            chunk[len++] = '\n';
+        if(len)
+            write(chunk, len);
+        text = next;
     }
 }
@@ -1,7 +1,15 @@
 #pragma once
 
+#include "Barcode.h"
+#include "CodePage.h"
+#include "Instrumentation.h"
 #include "QrCodeGen.hpp"
+#include "Raster.h"
 #include <Arduino.h>
+#include <optional>
+#include <span>
+#include <tuple>
+#include <vector>
 
 class ThermalPrinter : public Print {
 public:
@@ -21,12 +29,76 @@ public:
 
     enum class GraphicEncoding : uint8_t { uncompressed = 0, runLength, tiff, deltaRow };
 
+    /**
+     * Printer state as reported by getStatus(). valid is false if the printer
+     * did not answer, bufferFill (percent) and temperature (degree Celsius) are
+     * only known if the firmware sends the extended status.
+     */
+    struct Status {
+        bool valid{false};
+        bool paper{true};
+        bool busy{false};
+        bool bufferFull{false};
+        bool overheated{false};
+        std::optional<uint8_t> bufferFill;
+        std::optional<int8_t> temperature;
+    };
+
+    enum class Pacing : uint8_t { timed, status };
+
+    /**
+     * Switches the controller's side of the link, e.g. Serial1.begin(baud).
+     */
+    using BaudSetter = void (*)(uint32_t baud, void *context);
+
+    /**
+     * Result of the link negotiation in begin(), baud is 0 if the printer
+     * answered at none of the rates. roundTrip is the fastest echo in us,
+     * bytesPerSecond what the printer sustained for a burst of commands.
+     */
+    struct LinkSpeed {
+        uint32_t baud;
+        uint32_t roundTrip;
+        uint32_t bytesPerSecond;
+    };
+
+    static constexpr uint32_t defaultBaudRates[] = {921600, 460800, 230400, 115200, 57600, 19200, 9600};
+
+    /**
+     * Command sequence for the printer's batch memory, see recordBatch().
+     * duration is the modelled time the printer needs to execute it, pauses
+     * are the waits of the paced engine: us before the bytes from offset on.
+     */
+    struct Batch {
+        struct Pause {
+            uint32_t offset;
+            uint32_t us;
+        };
+        std::vector<uint8_t> data;
+        uint32_t duration{0};
+        std::vector<Pause> pauses;
+    };
+
 public:
     ThermalPrinter(Stream &s, bool useTimeout = true) : output{s}, useTimeout{useTimeout} { }
     ~ThermalPrinter() = default;
 
     void begin();
 
+    /**
+     * begin() that first finds the fastest rate the printer answers reliably
+     * at, for printers with a configured or auto detected rate. The rates are
+     * tried in order with echo probes and a burst of echo commands, the first
+     * one without a lost or garbled answer is kept. Its measured throughput
+     * replaces the default byte time of the pacing model. Without an answer
+     * the last rate stays set.
+     */
+    LinkSpeed begin(BaudSetter setBaud, void *context = nullptr, std::span<const uint32_t> rates = defaultBaudRates);
+
+    /**
+     * Text styles are sent lazily right before the next character, so
+     * redundant or reverted changes cost no bytes.
+     */
     void setBold(bool on);
     bool isBold() const { return bold; }
 
@@ -51,15 +123,66 @@ public:
     void setCharSpacing(int spacing = 0);
     uint8_t getCharSpacing() const { return charSpacing; }
 
-    void printTextSuperPosition(const char *text);
+    /**
+     * Print text over the previous text line, e.g. to strike it through.
+     * Returns false without printing if it does not fit in one line.
+     */
+    bool printTextSuperPosition(const char *text);
+
+    /**
+     * Text layout with the printer fonts. The lines are word wrapped to the
+     * paper width for the current doubleWidth and charSpacing, each one is
+     * sent as a single write after at most one setAbsoluteCursor(). A line in
+     * progress is finished first.
+     */
+    void printWrapped(const char *text, raster::Align align = raster::Align::left);
+
+    /**
+     * "item ....... price" line: left is wrapped, its last line is filled up to
+     * the right aligned right text.
+     */
+    void printColumns(const char *left, const char *right, char fill = '.');
+
+    /** Characters per line and the current cursor position, in characters */
+    size_t getColumns() const { return pxLine / charAdvance(); }
+    size_t getColumn() const { return column / charAdvance(); }
 
     void feed(uint8_t lines = 1);
 
     void feedPixel(uint16_t px);
 
+    /**
+     * Label mode: labels of pageLength dots, printing starts startOffset dots
+     * after the label gap, which the printer finds with its light barrier if
+     * gapSync is set. The vertical position of every line is tracked and
+     * consecutive feeds are merged into one paper movement.
+     */
+    void beginLabels(uint16_t pageLength, uint16_t startOffset = 0, bool gapSync = true);
+
+    /**
+     * Leave label mode. The finished label is fed tearOffset dots past the
+     * label start to the tear bar, the next output pulls it back with a
+     * reverse feed instead of ejecting a blank label.
+     */
+    void endLabels(uint16_t tearOffset = 0);
+
+    /**
+     * Feed to the start of the next label, nothing happens on an empty label.
+     */
+    void nextLabel();
+
+    /**
+     * Move to dot row y of the current label, backwards with a reverse feed.
+     */
+    void setLabelPosition(uint16_t y);
+    uint16_t getLabelPosition() const { return labelPos; }
+    bool isLabelMode() const { return labelMode; }
+
+    void cutPaper();
+
     void flush() { output.flush(); }
 
-    void setAbsoluteCursor(uint8_t cPos) { setAbsoluteCursor(uint16_t(cPos * 16)); }
+    void setAbsoluteCursor(uint8_t cPos) { setAbsoluteCursor(uint16_t(cPos * charWidth)); }
 
     void setAbsoluteCursor(uint16_t pxPos);
 
@@ -73,33 +196,102 @@ public:
 
     void printBarcode(const String text, BarcodeType type) { printBarcode(text.c_str(), type); }
 
+    /**
+     * Rasterize the barcode in the library and print it as graphics, with the
+     * largest module width that fits the paper. The height follows setBarcodeHeight().
+     * Returns false if the text can't be encoded or the symbol is too wide.
+     */
+    bool printBarcode(const char *text, raster::Symbology type);
+
+    bool printBarcode(const String text, raster::Symbology type) { return printBarcode(text.c_str(), type); }
+
+    /**
+     * zoom is the module size in dots, -1 selects the largest fitting one and 0 counts as 1.
+     */
     bool printQrCode(const char *text, int zoom = -1);
 
     bool printQrCode(const String text, int zoom = -1) { return printQrCode(text.c_str(), zoom); }
 
     bool printQrCode(const qrcodegen::QrCode &qrCode, int zoom = -1);
 
+    /**
+     * Print text as Data Matrix (ECC 200), the smallest square symbol that fits is used.
+     */
+    bool printDataMatrix(const char *text, int zoom = -1);
+
+    bool printDataMatrix(const String text, int zoom = -1) { return printDataMatrix(text.c_str(), zoom); }
+
+    /**
+     * Print any 2D module grid centered on the paper, zoom -1 selects the largest fitting zoom
+     * and 0 counts as 1, like for QR codes and Data Matrix.
+     */
+    bool printMatrix(const raster::Matrix &matrix, int zoom = -1, uint8_t border = 2);
+
     void setGraphicEncoding(GraphicEncoding compression);
 
     void printBitmap(size_t width, size_t height, const uint8_t *bitmap);
 
     template <size_t N> void printTiff(const tiffRaw<N> &tiff) {
-        writeCmd(true, cmd::graphicMode, to_underlying(GraphicEncoding::tiff));
+        selectGraphicEncoding(GraphicEncoding::tiff);
 
         size_t offset = 0;
         for(auto it = tiff.rowData.cbegin(); it != tiff.rowData.cend(); it++) {
             const auto len = *it;
-            writeCmd(false, cmd::printGraphicLine, len);
-            Print::write(tiff.data + offset, len);
-            timeoutWait();
+            sendGraphicLine(tiff.data + offset, len, countDots(tiff.data + offset, len, GraphicEncoding::tiff));
             offset += len;
         }
+        timeoutWait();
     }
 
+    /**
+     * Limit the number of dots the head may heat in one strobe. Lines with more
+     * black dots get one extra line time per exceeded budget, 0 disables the limit.
+     */
+    void setHeatBudget(uint16_t dots = defaultHeatBudget) { heatBudget = dots; }
+    uint16_t getHeatBudget() const { return heatBudget; }
+
+    /**
+     * Send a rendered band as compressed graphic lines.
+     */
+    void printBand(const raster::Band &band);
+
+    /**
+     * Render UTF-8 text with a compiled-in bitmap font (see tools/fontConverter.py)
+     * and print it as graphics. Text is word wrapped to the paper width, explicit
+     * newlines start a new line. Character spacing follows setCharSpacing().
+     */
+    void printText(const raster::Font &font, const char *text, raster::Align align = raster::Align::left);
+
+    void printText(const raster::Font &font, const String text, raster::Align align = raster::Align::left) { printText(font, text.c_str(), align); }
+
+    /**
+     * Code page the printer firmware is set to, printUtf8() transcodes to it.
+     * No command is sent.
+     */
+    void setCodePage(codepage::CodePage page) { codePage = page; }
+    codepage::CodePage getCodePage() const { return codePage; }
+
+    /**
+     * Lines with characters missing in the code page are rendered with this
+     * font as graphics, without one these characters print as '?'.
+     */
+    void setFallbackFont(const raster::Font *font) { fallbackFont = font; }
+
+    /**
+     * Print UTF-8 text in the printer's code page. The text is transcoded in
+     * small chunks on the stack, nothing is allocated.
+     */
+    void printUtf8(const char *text);
+
+    void printUtf8(const String &text) { printUtf8(text.c_str()); }
+
     void reset();
 
     // void normal();
 
+    /**
+     * Move to the next tab stop, every tabWidth dots like the firmware does.
+     */
     void tab();
 
     // void setCodePage(uint8_t code = 0);
@@ -112,10 +304,153 @@ public:
 
     // void printTestPage();
 
-    // bool hasPaper();
+    /**
+     * Ask the printer for its state and wait up to timeoutUs for the answer.
+     */
+    Status getStatus(uint32_t timeoutUs = defaultStatusTimeout);
+
+    /**
+     * True if the printer reports paper or does not answer at all.
+     */
+    bool hasPaper() {
+        const Status s = getStatus();
+        return !s.valid || s.paper;
+    }
+
+    /**
+     * Round trip time in us of a byte echoed by the printer, -1 on timeout.
+     */
+    int32_t echoLatency(uint8_t probe = 0x55, uint32_t timeoutUs = defaultStatusTimeout);
+
+    /**
+     * Pacing::timed pads every command with its modelled worst case duration.
+     * Pacing::status sends without waiting and asks for the status every
+     * statusInterval bytes, waiting only while the printer reports its buffer
+     * as near full. After an unanswered request, or a buffer that stays full
+     * for bufferFullTimeout, every command falls back to the timing model
+     * until a later request reports room.
+     */
+    void setPacing(Pacing mode, size_t statusInterval = defaultStatusInterval) {
+        pacing = mode;
+        this->statusInterval = statusInterval;
+        statusLost = false;
+    }
+    Pacing getPacing() const { return pacing; }
+
+    /**
+     * Time in us the pacing model allows per byte, begin() with a BaudSetter
+     * sets it from the measured throughput.
+     */
+    void setByteTime(uint32_t us) { byteTime = std::max<uint32_t>(us, 1); }
+    uint32_t getByteTime() const { return byteTime; }
 
     void timeoutWait();
 
+    /**
+     * True while the paced engine waits for the printer, a sender can hold
+     * back data until then instead of blocking in the next call.
+     */
+    bool isBusy() const { return useTimeout && int32_t(micros() - resumeTime) < 0; }
+
+    /**
+     * The stream to the printer, for a scheduler sending recorded jobs.
+     */
+    Stream &getStream() { return output; }
+
+    /**
+     * The printer got commands past the library, e.g. a job of a scheduler.
+     * Text style and graphic encoding are sent again before their next use.
+     */
+    void forgetPrinterState() {
+        printerStyle.reset();
+        activeEncoding.reset();
+    }
+
+    /**
+     * Same, the printer still needs busyFor µs for these commands before it
+     * takes the next one.
+     */
+    void forgetPrinterState(uint32_t busyFor) {
+        timeoutSet(busyFor);
+        forgetPrinterState();
+    }
+
+    /**
+     * Pass a raw command stream through, e.g. a job of a print server. The
+     * commands are followed across calls to pace the stream by its transfer
+     * and estimated paper time, status pacing only polls between commands.
+     * The library's idea of the printer's style and encoding is reset.
+     */
+    void writeRaw(const uint8_t *data, size_t len);
+
+    /**
+     * End a raw stream, e.g. when a print server job ends. A command the
+     * sender cut off is dropped, the next stream starts with a new command.
+     */
+    void endRaw() {
+        raw = RawCommand{};
+        rawZoom = ZoomLevel::single;
+    }
+
+    /**
+     * Record everything fn prints into a batch instead of sending it, e.g. a
+     * receipt header. The batch sets every text style and graphic encoding it
+     * uses itself, both are restored afterwards like the column, label
+     * position and a pending feed.
+     */
+    template <typename F> Batch recordBatch(F fn) {
+        Batch batch;
+        const StyleState saved = styleState();
+        const std::optional<TextStyle> savedPrinter = printerStyle;
+        const PositionState savedPosition = positionState();
+        printerStyle.reset();
+        activeEncoding.reset();
+        // a pending feed belongs to the live output, the batch starts on a new line
+        pendingFeed = 0;
+        column = 0;
+        recordedWait = 0;
+        recording = &batch;
+        fn();
+        // the wait after the last command
+        timeoutWait();
+        recording = nullptr;
+        styleState() = saved;
+        printerStyle = savedPrinter;
+        positionState() = savedPosition;
+        return batch;
+    }
+
+    /**
+     * Store a batch in the printer's batch memory, replacing the previous one.
+     * Returns false if it is empty or does not fit.
+     */
+    bool uploadBatch(const Batch &batch);
+
+    /**
+     * Execute the uploaded batch with a single short command.
+     * Returns false if no batch was uploaded.
+     */
+    bool runBatch();
+
+    /**
+     * Size of the printer's batch memory in bytes.
+     */
+    void setBatchCapacity(size_t bytes = defaultBatchCapacity) { batchCapacity = std::min<size_t>(bytes, 0xFFFF); }
+    size_t getBatchCapacity() const { return batchCapacity; }
+
+#ifdef THERMALPRINTER_INSTRUMENT
+    const instrumentation::Statistics &getStatistics() const { return stats; }
+    void resetStatistics() { stats = instrumentation::Statistics(); }
+
+    /**
+     * Called for every command with its timestamp and size, keep it short.
+     */
+    void setTraceHook(instrumentation::Hook hook, void *context = nullptr) {
+        traceHook = hook;
+        traceContext = context;
+    }
+#endif
+
 private:
     static constexpr char commandChar = 0x1B;
     enum class cmd : uint8_t {
@@ -151,11 +486,32 @@ private:
     };
 
     static constexpr uint32_t printerBootTime{2000};
-    static constexpr uint32_t byteTime = 250;
+    static constexpr uint32_t defaultByteTime = 250;
+    // echo commands in the throughput burst of the link negotiation
+    static constexpr size_t linkTestEchoes = 32;
     static constexpr size_t pxLine = 384;
+    static constexpr uint16_t defaultHeatBudget = 128;
+    static constexpr uint32_t defaultStatusTimeout = 50000;
+    static constexpr size_t defaultStatusInterval = 256;
+    static constexpr uint32_t statusPollTime = 5000;
+    static constexpr uint32_t bufferFullTimeout = 1000000;
+    static constexpr size_t defaultBatchCapacity = 4096;
+    static constexpr uint16_t charHeight = 24;
+    // all firmware fonts use the same cell
+    static constexpr uint16_t charWidth = 16;
+    static constexpr uint16_t tabWidth = 8 * charWidth;
+    static constexpr uint32_t cutTime = 500000;
+
+    // status byte, the extended flag announces a fill level and a temperature byte
+    static constexpr uint8_t statusPaperOut = 0x01;
+    static constexpr uint8_t statusBusy = 0x02;
+    static constexpr uint8_t statusBufferFull = 0x04;
+    static constexpr uint8_t statusOverheated = 0x08;
+    static constexpr uint8_t statusExtended = 0x80;
 
     Stream &output;
     bool useTimeout;
+    uint32_t byteTime{defaultByteTime};
 
     bool bold{false};
     bool underline{false};
@@ -165,33 +521,162 @@ private:
     uint8_t charSpacing{0};
     ZoomLevel heightZoom{ZoomLevel::single};
     GraphicEncoding compression{GraphicEncoding::uncompressed};
+    std::optional<GraphicEncoding> activeEncoding;
     bool doubleWidth{false};
 
+    // the style setters only change the members above, the printer gets the
+    // difference to its last known style right before the next text
+    struct TextStyle {
+        bool bold{false};
+        bool underline{false};
+        bool inverse{false};
+        bool upsideDown{false};
+        ZoomLevel heightZoom{ZoomLevel::single};
+        bool doubleWidth{false};
+        uint8_t fontIndex{0};
+        uint8_t charSpacing{0};
+    };
+    std::optional<TextStyle> printerStyle{TextStyle{}};
+    void flushStyle();
+
     uint16_t barcodeHeight{100};
     bool barcodeWithText{true};
 
+    codepage::CodePage codePage{codepage::CodePage::cp437};
+    const raster::Font *fallbackFont{nullptr};
+    void printText(const raster::Font &font, const char *text, const char *end, raster::Align align);
+
+    // command of a raw stream being passed through by writeRaw()
+    struct RawCommand {
+        uint8_t cmd{0};
+        uint8_t args[7]{};
+        uint8_t argCount{0};
+        uint8_t received{0};
+        bool escape{false};
+        // payload bytes of a graphic line, barcode or batch still to come
+        uint16_t payload{0};
+        size_t dots{0};
+    };
+    RawCommand raw;
+    // character height set by the raw stream
+    ZoomLevel rawZoom{ZoomLevel::single};
+    uint32_t rawTime(uint8_t c);
+    static constexpr uint8_t rawArgCount(uint8_t c);
+
+    // cursor position in the current text line, in dots
     size_t column{0};
-    size_t maxColumn{48};
-    char prevByte{0};
+    uint16_t charAdvance() const { return (charWidth + charSpacing) * (doubleWidth ? 2 : 1); }
+    void advanceColumn(uint8_t c);
+    const char *wrapLine(const char *text, size_t columns, size_t &len) const;
+    void printLine(const char *text, size_t len, raster::Align align);
 
     static constexpr uint32_t dotPrintTime{30000};
     static constexpr uint32_t dotFeedTime{2100};
     uint32_t resumeTime{0};
     void timeoutSet(uint32_t timeout);
 
+    Pacing pacing{Pacing::timed};
+    size_t statusInterval{defaultStatusInterval};
+    // bytes sent since the printer last reported room in its buffer
+    size_t unconfirmed{0};
+    // the last status request went unanswered or the buffer stayed full
+    bool statusLost{false};
+    bool waitForBuffer();
+    int readResponse(uint32_t timeoutUs);
+    void discardInput();
+    LinkSpeed measureLink();
+
+    size_t batchCapacity{defaultBatchCapacity};
+    std::optional<uint32_t> batchDuration;
+    // commands go into this batch instead of the stream while recording
+    Batch *recording{nullptr};
+    // last timeoutSet() while recording, it becomes a pause at the next timeoutWait()
+    uint32_t recordedWait{0};
+
+    bool labelMode{false};
+    uint16_t labelLength{0};
+    uint16_t labelPos{0};
+    // paper movement not sent yet, negative is a reverse feed
+    int32_t pendingFeed{0};
+    void advanceLabel(uint16_t dots);
+    void flushFeed();
+
+    using StyleState = std::tuple<bool, bool, bool, bool, uint8_t, uint8_t, ZoomLevel, GraphicEncoding, std::optional<GraphicEncoding>, bool>;
+    auto styleState() { return std::tie(bold, underline, inverse, upsideDown, fontIndex, charSpacing, heightZoom, compression, activeEncoding, doubleWidth); }
+    using PositionState = std::tuple<size_t, uint16_t, int32_t, size_t>;
+    auto positionState() { return std::tie(column, labelPos, pendingFeed, unconfirmed); }
+
+    void put(uint8_t c) {
+        if(recording)
+            recording->data.push_back(c);
+        else
+            output.write(c);
+    }
+
+    void put(const uint8_t *data, size_t len) {
+        if(recording)
+            recording->data.insert(recording->data.end(), data, data + len);
+        else
+            output.write(data, len);
+    }
+
+    uint16_t heatBudget{defaultHeatBudget};
+    uint32_t lineTime(size_t dots) const;
+    // paper feed of a newline in text mode
+    static constexpr uint32_t newlineTime(ZoomLevel zoom) { return uint32_t(zoom) * 32 * dotFeedTime; }
+    static size_t countDots(const uint8_t *data, size_t len, GraphicEncoding encoding);
+    // PackBits of a full dot line, timed as compression when instrumented
+    size_t packLine(const uint8_t *line, uint8_t *packed);
+    void sendGraphicLine(const uint8_t *data, size_t len, size_t dots);
+    void selectGraphicEncoding(GraphicEncoding encoding);
+    template <typename F> bool printModules(size_t width, size_t height, int zoom, uint8_t border, F getModule);
+
     std::pair<size_t, size_t> getMaxSizeCode(BarcodeType t, size_t chars);
 
     template <typename... T> void writeCmd(bool delay, cmd c, T const &...values) {
         if(delay)
             timeoutWait();
-        output.write(commandChar);
-        output.write(to_underlying(c));
-        ((void)output.write(values), ...);
+        const uint32_t start = traceStart();
+        put(commandChar);
+        put(to_underlying(c));
+        ((void)put(uint8_t(values)), ...);
         const size_t count = sizeof...(T);
+        traceCommand(to_underlying(c), count + 2, start);
+        unconfirmed += count + 2;
         timeoutSet(count * byteTime);
     }
 
+#ifdef THERMALPRINTER_INSTRUMENT
+    instrumentation::Statistics stats;
+    instrumentation::Hook traceHook{nullptr};
+    void *traceContext{nullptr};
+#endif
+
+    uint32_t traceStart() const {
+#ifdef THERMALPRINTER_INSTRUMENT
+        return micros();
+#else
+        return 0;
+#endif
+    }
+
+    void traceCommand([[maybe_unused]] uint8_t c, [[maybe_unused]] size_t bytes, [[maybe_unused]] uint32_t start) {
+#ifdef THERMALPRINTER_INSTRUMENT
+        const instrumentation::Event event{start, c, uint16_t(bytes)};
+        stats.streamUs += micros() - start;
+        if(c == instrumentation::textCmd)
+            stats.textBytes += bytes;
+        else
+            stats.cmdBytes[c & 0x7F] += bytes;
+        stats.record(event);
+        if(traceHook)
+            traceHook(event, traceContext);
+#endif
+    }
+
     virtual size_t write(uint8_t c) override;
+    // text spans are sent in runs up to the next newline with one pacing step per run
+    virtual size_t write(const uint8_t *buffer, size_t size) override;
 
     template <typename E> constexpr typename std::underlying_type<E>::type to_underlying(E e) noexcept {
         return static_cast<typename std::underlying_type<E>::type>(e);
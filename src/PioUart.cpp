@@ -0,0 +1,199 @@
+#include "PioUart.h"
+
+#include <hardware/clocks.h>
+#include <hardware/sync.h>
+
+namespace {
+
+// 8 PIO cycles per bit, the TX pin is side-set so it stays high while waiting
+//
+//     .side_set 1 opt
+//         pull            side 1 [7]   ; stop bit, then idle until the next byte
+//         wait 0 pin 0                 ; CTS, replaced by a nop without flow control
+//         set x, 7        side 0 [7]   ; start bit
+//     bitloop:
+//         out pins, 1
+//         jmp x-- bitloop        [6]
+constexpr uint16_t waitCts = 0x2020;
+constexpr uint16_t nop = 0xA042;
+constexpr uint16_t txProgram[] = {0x9FA0, waitCts, 0xF727, 0x6001, 0x0643};
+constexpr uint32_t cyclesPerBit = 8;
+
+} // namespace
+
+PioUart *PioUart::dmaOwners[NUM_DMA_CHANNELS];
+
+uint32_t PioUart::dividerFor(uint32_t baud) {
+    if(baud == 0)
+        return 0;
+    const uint32_t div = (uint64_t(clock_get_hz(clk_sys)) * 256 / cyclesPerBit + baud / 2) / baud;
+    // the integer part is 1 to 65535
+    return (div >= 0x100 && div < 0x1000000) ? div : 0;
+}
+
+bool PioUart::begin(uint32_t baud) {
+    end();
+    divider = dividerFor(baud);
+    if(divider == 0)
+        return false;
+
+    uint16_t instructions[std::size(txProgram)];
+    std::copy(std::begin(txProgram), std::end(txProgram), instructions);
+    if(ctsPin == noPin)
+        instructions[1] = nop;
+    pio_program_t program{};
+    program.instructions = instructions;
+    program.length = std::size(instructions);
+    program.origin = -1;
+    if(!pio_can_add_program(pio, &program))
+        return false;
+    sm = pio_claim_unused_sm(pio, false);
+    dma = dma_claim_unused_channel(false);
+    if(sm < 0 || dma < 0) {
+        end();
+        return false;
+    }
+    offset = pio_add_program(pio, &program);
+
+    // idle high before the pin is handed to the PIO
+    pio_sm_set_pins_with_mask(pio, sm, 1u << txPin, 1u << txPin);
+    pio_sm_set_pindirs_with_mask(pio, sm, 1u << txPin, 1u << txPin);
+    pio_gpio_init(pio, txPin);
+    pio_sm_config config = pio_get_default_sm_config();
+    sm_config_set_wrap(&config, offset, offset + program.length - 1);
+    sm_config_set_sideset(&config, 2, true, false);
+    sm_config_set_sideset_pins(&config, txPin);
+    sm_config_set_out_pins(&config, txPin, 1);
+    sm_config_set_out_shift(&config, true, false, 32);
+    sm_config_set_fifo_join(&config, PIO_FIFO_JOIN_TX);
+    if(ctsPin != noPin) {
+        gpio_init(ctsPin);
+        gpio_set_dir(ctsPin, GPIO_IN);
+        sm_config_set_in_pins(&config, ctsPin);
+    }
+    sm_config_set_clkdiv_int_frac(&config, divider >> 8, divider & 0xFF);
+    pio_sm_init(pio, sm, offset, &config);
+    pio_sm_set_enabled(pio, sm, true);
+
+    // byte writes to the FIFO are replicated over the word, the LSB goes out first
+    dma_channel_config dmaConfig = dma_channel_get_default_config(dma);
+    channel_config_set_transfer_data_size(&dmaConfig, DMA_SIZE_8);
+    channel_config_set_read_increment(&dmaConfig, true);
+    channel_config_set_write_increment(&dmaConfig, false);
+    channel_config_set_dreq(&dmaConfig, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(dma, &dmaConfig, &pio->txf[sm], nullptr, 0, false);
+
+    dmaOwners[dma] = this;
+    static bool handlerInstalled = false;
+    if(!handlerInstalled) {
+        irq_add_shared_handler(DMA_IRQ_0, dmaHandler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0, true);
+        handlerInstalled = true;
+    }
+    dma_channel_set_irq0_enabled(dma, true);
+    return true;
+}
+
+void PioUart::end() {
+    if(dma >= 0) {
+        dma_channel_set_irq0_enabled(dma, false);
+        dma_channel_abort(dma);
+        dma_channel_acknowledge_irq0(dma);
+        dmaOwners[dma] = nullptr;
+        dma_channel_unclaim(dma);
+        dma = -1;
+    }
+    if(sm >= 0) {
+        pio_sm_set_enabled(pio, sm, false);
+        pio_sm_unclaim(pio, sm);
+        sm = -1;
+    }
+    if(offset >= 0) {
+        // only the length matters for removing it
+        pio_program_t program{};
+        program.instructions = txProgram;
+        program.length = std::size(txProgram);
+        program.origin = -1;
+        pio_remove_program(pio, &program, offset);
+        offset = -1;
+    }
+    ring.consume(ring.used());
+    inFlight = 0;
+}
+
+bool PioUart::setBaud(uint32_t baud) {
+    const uint32_t div = dividerFor(baud);
+    if(div == 0 || sm < 0)
+        return false;
+    flush();
+    divider = div;
+    pio_sm_set_clkdiv_int_frac(pio, sm, divider >> 8, divider & 0xFF);
+    pio_sm_clkdiv_restart(pio, sm);
+    return true;
+}
+
+uint32_t PioUart::getBaud() const {
+    return divider ? uint64_t(clock_get_hz(clk_sys)) * 256 / cyclesPerBit / divider : 0;
+}
+
+int PioUart::availableForWrite() {
+    const uint32_t state = save_and_disable_interrupts();
+    const size_t free = ring.free();
+    restore_interrupts(state);
+    return free;
+}
+
+size_t PioUart::write(const uint8_t *buffer, size_t size) {
+    if(sm < 0)
+        return 0;
+    size_t written = 0;
+    while(written < size) {
+        // the interrupt only moves the tail, so the free span can't shrink
+        uint32_t state = save_and_disable_interrupts();
+        size_t len;
+        uint8_t *span = ring.writeSpan(len);
+        restore_interrupts(state);
+        if(len == 0) {
+            yield();
+            continue;
+        }
+        len = std::min(len, size - written);
+        memcpy(span, buffer + written, len);
+        written += len;
+
+        state = save_and_disable_interrupts();
+        ring.commit(len);
+        if(inFlight == 0)
+            startTransfer();
+        restore_interrupts(state);
+    }
+    return written;
+}
+
+void PioUart::flush() {
+    if(sm < 0)
+        return;
+    // a byte held back by CTS waits before its start bit
+    while(inFlight != 0 || !pio_sm_is_tx_fifo_empty(pio, sm) || pio_sm_get_pc(pio, sm) == offset + 1)
+        yield();
+    // the state machine may still shift out the last byte it pulled
+    delayMicroseconds(10'000'000 / getBaud() + 1);
+}
+
+void PioUart::startTransfer() {
+    size_t len;
+    const uint8_t *span = ring.readSpan(len);
+    inFlight = len;
+    if(len)
+        dma_channel_transfer_from_buffer_now(dma, span, len);
+}
+
+void PioUart::dmaHandler() {
+    for(PioUart *uart : dmaOwners) {
+        if(uart == nullptr || !dma_channel_get_irq0_status(uart->dma))
+            continue;
+        dma_channel_acknowledge_irq0(uart->dma);
+        uart->ring.consume(uart->inFlight);
+        uart->startTransfer();
+    }
+}
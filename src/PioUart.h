@@ -0,0 +1,74 @@
+#pragma once
+
+#include "UartBridge.h"
+#include <Arduino.h>
+#include <hardware/dma.h>
+#include <hardware/pio.h>
+
+/**
+ * Transmit only UART on a PIO state machine, for more printer channels than
+ * the two hardware UARTs and for baud rates the UART divider can't hit: any
+ * rate up to an eighth of the system clock, with a 1/256 fractional divider.
+ *
+ * write() copies into a ring buffer that DMA feeds to the state machine, it
+ * only blocks while the buffer is full. With a CTS pin the state machine holds
+ * every start bit until the printer pulls CTS low, so a busy printer stops the
+ * transfer in hardware. There is no receive path, the printer has to use
+ * ThermalPrinter::Pacing::timed.
+ */
+class PioUart : public Stream {
+public:
+    static constexpr size_t bufferSize = 1024;
+    static constexpr uint8_t noPin = 0xFF;
+
+    explicit PioUart(uint8_t txPin, uint8_t ctsPin = noPin, PIO pio = pio0) : txPin{txPin}, ctsPin{ctsPin}, pio{pio} { }
+    ~PioUart() override { end(); }
+
+    /**
+     * Claim a state machine and a DMA channel, false if none is free or the
+     * rate is out of range.
+     */
+    bool begin(uint32_t baud);
+    void end();
+
+    /**
+     * Change the rate after the buffered bytes went out.
+     */
+    bool setBaud(uint32_t baud);
+    /**
+     * Rate the divider actually produces.
+     */
+    uint32_t getBaud() const;
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    int availableForWrite() override;
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+    /**
+     * Wait until the last stop bit is on the line.
+     */
+    void flush() override;
+
+private:
+    const uint8_t txPin;
+    const uint8_t ctsPin;
+    const PIO pio;
+    int sm{-1};
+    int dma{-1};
+    int offset{-1};
+    // system clocks per bit in 1/256
+    uint32_t divider{0};
+
+    RingBuffer<bufferSize> ring;
+    // length of the DMA transfer running, consumed by the interrupt
+    volatile size_t inFlight{0};
+
+    static PioUart *dmaOwners[NUM_DMA_CHANNELS];
+    static void dmaHandler();
+
+    void startTransfer();
+    static uint32_t dividerFor(uint32_t baud);
+};
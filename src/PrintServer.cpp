@@ -0,0 +1,38 @@
+#include "PrintServer.h"
+
+void PrintServer::poll(Stream &source) {
+    // e.g. the answer to a status request of the host
+    while(port.available() > 0)
+        source.write(uint8_t(port.read()));
+
+    const int available = source.available();
+    if(available <= 0) {
+        if(job && millis() - lastData >= jobGapMs)
+            endJob();
+        return;
+    }
+    if(printer.isBusy()) {
+        // the data stays in the source and throttles the sender
+        stats.stalls++;
+        return;
+    }
+
+    if(!job) {
+        job = true;
+        stats.jobs++;
+    }
+    const size_t len = source.readBytes(block, std::min<size_t>(available, blockSize));
+    printer.writeRaw(block, len);
+    stats.bytes += len;
+    stats.blocks++;
+    lastData = millis();
+}
+
+void PrintServer::endJob() {
+    if(!job)
+        return;
+    job = false;
+    // a command cut off by the sender must not swallow the next job
+    printer.endRaw();
+    printer.flush();
+}
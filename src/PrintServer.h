@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ThermalPrinter.h>
+
+/**
+ * Print server front end: takes raw printer jobs from a stream (USB CDC or a
+ * TCP client), collects them in large blocks and hands them to the printer's
+ * paced engine with ThermalPrinter::writeRaw(). Nothing is read from the
+ * source while the printer is busy, so the sender is held back by the USB or
+ * TCP flow control instead of overrunning the printer or the UART FIFO.
+ *
+ * A job ends when the source disconnects (endJob()) or sends nothing for the
+ * job gap. Answers of the printer are passed back to the source.
+ */
+class PrintServer {
+public:
+    static constexpr size_t blockSize = 1024;
+    static constexpr uint32_t defaultJobGapMs = 500;
+
+    struct Stats {
+        uint32_t jobs;
+        uint32_t bytes;
+        uint32_t blocks;
+        // polls with data waiting while the printer was busy
+        uint32_t stalls;
+    };
+
+    PrintServer(ThermalPrinter &printer, Stream &printerPort) : printer{printer}, port{printerPort} { }
+
+    /**
+     * Move the next block from the source to the printer, call this from loop().
+     */
+    void poll(Stream &source);
+
+    void endJob();
+    bool inJob() const { return job; }
+
+    void setJobGap(uint32_t ms) { jobGapMs = ms; }
+    const Stats &getStats() const { return stats; }
+
+private:
+    ThermalPrinter &printer;
+    Stream &port;
+    uint8_t block[blockSize];
+    bool job{false};
+    uint32_t lastData{0};
+    uint32_t jobGapMs{defaultJobGapMs};
+    Stats stats{};
+};
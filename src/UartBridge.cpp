@@ -0,0 +1,48 @@
+#include "UartBridge.h"
+
+template <size_t N> size_t UartBridge::fill(Stream &from, RingBuffer<N> &ring) {
+    size_t total = 0;
+    // the span may end at the wrap around, then a second one follows
+    for(int pass = 0; pass < 2; pass++) {
+        const int available = from.available();
+        size_t len;
+        uint8_t *span = ring.writeSpan(len);
+        if(available <= 0 || len == 0)
+            break;
+        const size_t n = from.readBytes(span, std::min<size_t>(available, len));
+        ring.commit(n);
+        total += n;
+    }
+    return total;
+}
+
+template <size_t N> size_t UartBridge::drain(RingBuffer<N> &ring, Stream &to) {
+    size_t total = 0;
+    for(int pass = 0; pass < 2; pass++) {
+        const int room = to.availableForWrite();
+        size_t len;
+        const uint8_t *span = ring.readSpan(len);
+        if(room <= 0 || len == 0)
+            break;
+        const size_t n = to.write(span, std::min<size_t>(room, len));
+        ring.consume(n);
+        total += n;
+    }
+    return total;
+}
+
+void UartBridge::poll() {
+    fill(host, toPrinter);
+    if(toPrinter.free() == 0 && host.available() > 0)
+        counters.hostStalls++;
+    counters.maxFill = std::max(counters.maxFill, toPrinter.used());
+    if(toPrinter.used()) {
+        const size_t sent = drain(toPrinter, printer);
+        if(sent == 0)
+            counters.printerStalls++;
+        counters.toPrinter += sent;
+    }
+
+    fill(printer, toHost);
+    counters.toHost += drain(toHost, host);
+}
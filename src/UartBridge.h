@@ -0,0 +1,82 @@
+#pragma once
+
+#include <Arduino.h>
+#include <algorithm>
+#include <array>
+
+/**
+ * Byte ring buffer, N has to be a power of two. Data goes in and out in
+ * contiguous spans, so the streams can be read and written in bulk.
+ */
+template <size_t N> class RingBuffer {
+    static_assert((N & (N - 1)) == 0, "ring buffer size has to be a power of two");
+
+public:
+    size_t used() const { return head - tail; }
+    size_t free() const { return N - used(); }
+
+    // free space up to the end of the storage
+    uint8_t *writeSpan(size_t &len) {
+        const size_t start = head % N;
+        len = std::min(free(), N - start);
+        return data.data() + start;
+    }
+    void commit(size_t len) { head += len; }
+
+    // buffered data up to the end of the storage
+    const uint8_t *readSpan(size_t &len) const {
+        const size_t start = tail % N;
+        len = std::min(used(), N - start);
+        return data.data() + start;
+    }
+    void consume(size_t len) { tail += len; }
+
+private:
+    std::array<uint8_t, N> data{};
+    // free running, the difference is the fill level
+    size_t head{0};
+    size_t tail{0};
+};
+
+/**
+ * Transparent USB to UART bridge for PC driven printing. Both directions go
+ * through ring buffers in bulk transfers. Nothing is read from the host while
+ * the buffer towards the printer is full, so a printer holding CTS pushes back
+ * to the USB host instead of losing bytes.
+ */
+class UartBridge {
+public:
+    // about 80 uncompressed graphic lines of 51 bytes
+    static constexpr size_t toPrinterSize = 4096;
+    static constexpr size_t toHostSize = 256;
+
+    struct Counters {
+        uint32_t toPrinter;
+        uint32_t toHost;
+        // polls the host had data but the buffer was full
+        uint32_t hostStalls;
+        // polls with buffered data but no room in the UART, e.g. CTS held
+        uint32_t printerStalls;
+        size_t maxFill;
+    };
+
+    UartBridge(Stream &host, Stream &printer) : host{host}, printer{printer} { }
+
+    /**
+     * Move what is possible without blocking in both directions, call this from loop().
+     */
+    void poll();
+
+    const Counters &getCounters() const { return counters; }
+    void resetCounters() { counters = {}; }
+
+private:
+    Stream &host;
+    Stream &printer;
+    RingBuffer<toPrinterSize> toPrinter;
+    RingBuffer<toHostSize> toHost;
+    Counters counters{};
+
+    template <size_t N> static size_t fill(Stream &from, RingBuffer<N> &ring);
+    template <size_t N> static size_t drain(RingBuffer<N> &ring, Stream &to);
+};
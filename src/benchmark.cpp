@@ -0,0 +1,177 @@
+// Receipt benchmark firmware, built by the "benchmark" environment.
+// Runs a fixed corpus of jobs against a capturing stream and reports the CPU
+// time per stage and the emitted command stream over Serial. The corpus runs
+// three times: a warm up, a timed pass and a pass dumping the streams, so the
+// serial output never ends up in the timings.
+// tools/benchmarkReport.py turns the log into a machine-readable report.
+#include <Arduino.h>
+#include <Compositor.h>
+#include <ThermalPrinter.h>
+#include <memory>
+
+#include "images.h"
+
+using qrcodegen::QrCode;
+
+// Counts everything the printer sends and optionally dumps it as hex.
+class CaptureStream : public Stream {
+public:
+    void start(const char *name, bool dump) {
+        job = name;
+        dumping = dump;
+        count = 0;
+        fill = 0;
+    }
+
+    size_t finish() {
+        flushLine();
+        dumping = false;
+        return count;
+    }
+
+    size_t write(uint8_t c) override {
+        count++;
+        if(dumping) {
+            line[fill++] = c;
+            if(fill == sizeof(line))
+                flushLine();
+        }
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+        for(size_t i = 0; i < size; i++)
+            write(buffer[i]);
+        return size;
+    }
+
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+
+private:
+    const char *job{""};
+    bool dumping{false};
+    size_t count{0};
+    uint8_t line[64];
+    size_t fill{0};
+
+    void flushLine() {
+        if(fill == 0)
+            return;
+        Serial.printf("DATA %s ", job);
+        for(size_t i = 0; i < fill; i++)
+            Serial.printf("%02X", line[i]);
+        Serial.println();
+        fill = 0;
+    }
+};
+
+static CaptureStream capture;
+// no pacing, the benchmark measures CPU time only
+static ThermalPrinter printer(capture, false);
+
+static constexpr size_t logoWidth = 384;
+static constexpr size_t logoHeight = 800;
+static std::unique_ptr<uint8_t[]> logo;
+
+static void makeLogo() {
+    // concentric rings with a solid bar, a mix of dense and sparse lines
+    logo = std::make_unique<uint8_t[]>(logoWidth / 8 * logoHeight);
+    for(size_t y = 0; y < logoHeight; y++) {
+        for(size_t x = 0; x < logoWidth; x++) {
+            const int dx = int(x) - 192;
+            const int dy = int(y % 400) - 200;
+            const bool on = ((dx * dx + dy * dy) / 600) % 2 || (y > 380 && y < 420);
+            if(on)
+                logo[y * logoWidth / 8 + x / 8] |= 0x80 >> (x % 8);
+        }
+    }
+}
+
+enum class Pass { warmUp, timed, dump };
+
+// print_us is split into compression and the writes to the stream, the rest is rasterizing
+static void report(const char *job, uint32_t encodeUs, uint32_t printUs) {
+    const size_t bytes = capture.finish();
+    const instrumentation::Statistics &stats = printer.getStatistics();
+    const uint32_t transmitUs = stats.streamUs;
+    const uint32_t compressUs = stats.compressUs;
+    const uint32_t rasterizeUs = printUs - std::min(printUs, transmitUs + compressUs);
+    Serial.printf("BENCH {\"job\":\"%s\",\"encode_us\":%lu,\"print_us\":%lu,\"rasterize_us\":%lu,\"compress_us\":%lu,\"transmit_us\":%lu,\"bytes\":%u}\n",
+        job, (unsigned long)encodeUs, (unsigned long)printUs, (unsigned long)rasterizeUs, (unsigned long)compressUs, (unsigned long)transmitUs,
+        (unsigned)bytes);
+}
+
+template <typename E, typename P> static void runJob(const char *job, Pass pass, E encode, P print) {
+    printer.reset();
+    capture.start(job, pass == Pass::dump);
+    uint32_t start = micros();
+    auto encoded = encode();
+    const uint32_t encodeUs = micros() - start;
+    printer.resetStatistics();
+    start = micros();
+    print(encoded);
+    const uint32_t printUs = micros() - start;
+    if(pass == Pass::timed)
+        report(job, encodeUs, printUs);
+    else
+        capture.finish();
+}
+
+static void runCorpus(Pass pass) {
+    auto none = [] { return 0; };
+
+    runJob("text_receipt", pass, none, [](int) {
+        printer.println("ACME Coffee");
+        printer.println("Main Street 1");
+        printer.setBold(true);
+        printer.println("Receipt 0042");
+        printer.setBold(false);
+        for(int i = 0; i < 10; i++)
+            printer.printf("Item %d            %3d.%02d\n", i, i * 3, i * 7 % 100);
+        printer.setDoubleWidth(true);
+        printer.println("Total        27.35");
+        printer.setDoubleWidth(false);
+        printer.feed(3);
+    });
+
+    static char payload[1001];
+    for(size_t i = 0; i < sizeof(payload) - 1; i++)
+        payload[i] = 'A' + (i * 7) % 26;
+    runJob("qr_1000", pass, [] { return QrCode::encodeText(payload, QrCode::Ecc::ECC_LOW); }, [](const QrCode &qr) { printer.printQrCode(qr); });
+
+    runJob("logo_uncompressed", pass, none, [](int) { printer.printBitmap(logoWidth, logoHeight, logo.get()); });
+
+    runJob(
+        "logo_tiff", pass,
+        [] {
+            auto comp = std::make_unique<raster::Compositor>();
+            comp->addBitmap(0, 0, logoWidth, logoHeight, logo.get());
+            return comp;
+        },
+        [](const std::unique_ptr<raster::Compositor> &comp) { comp->print(printer); });
+
+    runJob("barcode_code39", pass, none, [](int) { printer.printBarcode("123ABC", ThermalPrinter::BarcodeType::CODE39); });
+    runJob("barcode_itf", pass, none, [](int) { printer.printBarcode("12345678", ThermalPrinter::BarcodeType::ITF); });
+    runJob("barcode_ean13", pass, none, [](int) { printer.printBarcode("400638133393", ThermalPrinter::BarcodeType::EAN13); });
+    runJob("barcode_ean8", pass, none, [](int) { printer.printBarcode("9638507", ThermalPrinter::BarcodeType::EAN8); });
+    runJob("raster_code128", pass, none, [](int) { printer.printBarcode("ACME-0042-27.35", raster::Symbology::code128); });
+
+    runJob("tiff_test_png", pass, none, [](int) { printer.printTiff(test_png); });
+}
+
+void setup() {
+    Serial.begin(115200);
+    while(!Serial)
+        delay(10);
+
+    makeLogo();
+    Serial.printf("BENCH {\"library\":\"ThermalPrinter\",\"f_cpu\":%lu}\n", (unsigned long)F_CPU);
+    runCorpus(Pass::warmUp);
+    runCorpus(Pass::timed);
+    runCorpus(Pass::dump);
+    Serial.println("BENCH {\"done\":true}");
+}
+
+void loop() { }
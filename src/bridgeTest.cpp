@@ -0,0 +1,185 @@
+// Host tests of the ring buffer and the USB to UART bridge, built by the
+// "bridge_native" environment. Covers the empty and full ring, data crossing
+// the wrap around, and a host sending more than the bridge can buffer while
+// the printer holds CTS.
+//
+//     pio run -e bridge_native -t exec
+#include "UartBridge.h"
+#include <Arduino.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace {
+
+bool passed;
+
+void check(bool condition, const char *what) {
+    if(condition)
+        return;
+    printf("  %s\n", what);
+    passed = false;
+}
+
+// Input queued by the test, output collected. The room for writes is limited
+// like a UART FIFO, a room of 0 stands for a printer holding CTS.
+class FifoStream : public Stream {
+public:
+    std::deque<uint8_t> input;
+    std::vector<uint8_t> output;
+    int room{0};
+
+    int available() override { return input.size(); }
+    int read() override {
+        if(input.empty())
+            return -1;
+        const uint8_t c = input.front();
+        input.pop_front();
+        return c;
+    }
+    int peek() override { return input.empty() ? -1 : input.front(); }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override {
+        size = std::min<size_t>(size, std::max(room, 0));
+        output.insert(output.end(), buffer, buffer + size);
+        room -= size;
+        return size;
+    }
+    int availableForWrite() override { return room; }
+
+    void send(size_t count, uint8_t first = 0) {
+        for(size_t i = 0; i < count; i++)
+            input.push_back(uint8_t(first + i));
+    }
+};
+
+bool isSequence(const std::vector<uint8_t> &data, size_t count, uint8_t first = 0) {
+    if(data.size() != count)
+        return false;
+    for(size_t i = 0; i < count; i++)
+        if(data[i] != uint8_t(first + i))
+            return false;
+    return true;
+}
+
+struct Case {
+    const char *name;
+    std::function<void()> run;
+};
+
+const Case cases[] = {
+    {"ringEmpty", [] {
+         RingBuffer<8> ring;
+         size_t len;
+         ring.readSpan(len);
+         check(len == 0, "an empty ring has nothing to read");
+         check(ring.used() == 0 && ring.free() == 8, "an empty ring is all free");
+         ring.writeSpan(len);
+         check(len == 8, "an empty ring takes the whole storage");
+     }},
+    {"ringFull", [] {
+         RingBuffer<8> ring;
+         size_t len;
+         ring.writeSpan(len);
+         ring.commit(len);
+         check(ring.used() == 8 && ring.free() == 0, "the ring is full");
+         ring.writeSpan(len);
+         check(len == 0, "a full ring takes nothing");
+         ring.readSpan(len);
+         check(len == 8, "a full ring reads the whole storage");
+         ring.consume(len);
+         check(ring.used() == 0, "the ring is empty again");
+     }},
+    {"ringWrapAround", [] {
+         RingBuffer<8> ring;
+         size_t len;
+         ring.writeSpan(len);
+         ring.commit(6);
+         ring.consume(6);
+         // 7 bytes from the end of the storage across the wrap around
+         uint8_t *span = ring.writeSpan(len);
+         check(len == 2, "the write span ends at the end of the storage");
+         span[0] = 1;
+         span[1] = 2;
+         ring.commit(2);
+         span = ring.writeSpan(len);
+         check(len == 6, "the next write span starts at the beginning");
+         for(uint8_t i = 0; i < 5; i++)
+             span[i] = 3 + i;
+         ring.commit(5);
+         check(ring.used() == 7 && ring.free() == 1, "fill level across the wrap around");
+
+         std::vector<uint8_t> read;
+         for(int pass = 0; pass < 2; pass++) {
+             const uint8_t *data = ring.readSpan(len);
+             read.insert(read.end(), data, data + len);
+             ring.consume(len);
+         }
+         check(isSequence(read, 7, 1), "the bytes come out in order in two spans");
+         ring.readSpan(len);
+         check(len == 0, "the ring is empty after reading both spans");
+     }},
+    {"bridgeTransparent", [] {
+         FifoStream host, printer;
+         UartBridge bridge(host, printer);
+         printer.room = 64;
+         host.send(40);
+         printer.send(3, 0x10);
+         bridge.poll();
+         check(isSequence(printer.output, 40), "the host bytes reach the printer");
+         host.room = 64;
+         bridge.poll();
+         check(isSequence(host.output, 3, 0x10), "the printer status reaches the host");
+         const UartBridge::Counters &c = bridge.getCounters();
+         check(c.toPrinter == 40 && c.toHost == 3, "the counters match the bytes moved");
+     }},
+    {"bridgeWrapAround", [] {
+         // the printer takes less than the host sends, so the buffer wraps many times
+         FifoStream host, printer;
+         UartBridge bridge(host, printer);
+         const size_t total = 3 * UartBridge::toPrinterSize + 100;
+         host.send(total);
+         while(!host.input.empty() || bridge.getCounters().toPrinter < total) {
+             printer.room = 1000;
+             bridge.poll();
+         }
+         check(isSequence(printer.output, total), "all bytes arrive in order");
+     }},
+    {"bridgeOverflow", [] {
+         // the printer holds CTS while the host sends more than the buffer holds
+         FifoStream host, printer;
+         UartBridge bridge(host, printer);
+         const size_t total = UartBridge::toPrinterSize + 500;
+         host.send(total);
+         bridge.poll();
+         bridge.poll();
+         const UartBridge::Counters &c = bridge.getCounters();
+         check(c.maxFill == UartBridge::toPrinterSize, "the buffer fills up");
+         check(host.input.size() == 500, "the rest stays with the host");
+         check(c.hostStalls == 2, "every poll with a full buffer counts a host stall");
+         check(c.printerStalls == 2, "every poll without room counts a printer stall");
+         check(printer.output.empty(), "nothing is sent while CTS is held");
+
+         printer.room = total;
+         bridge.poll();
+         bridge.poll();
+         check(isSequence(printer.output, total), "no byte is lost or reordered");
+         check(host.input.empty(), "the host data is taken once there is room");
+     }},
+};
+
+} // namespace
+
+int main() {
+    size_t failed = 0;
+    for(const Case &c : cases) {
+        passed = true;
+        c.run();
+        if(passed)
+            continue;
+        failed++;
+        printf("FAIL %s\n", c.name);
+    }
+    printf("%zu of %zu cases passed\n", std::size(cases) - failed, std::size(cases));
+    return failed ? 1 : 0;
+}
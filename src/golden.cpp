@@ -0,0 +1,592 @@
+// Golden byte regression tests, built by the "golden_native" environment.
+// Every case drives one public ThermalPrinter method against a capturing stream
+// on the host. The bytes sent and the virtual time they were sent at (which
+// reflects all timeoutSet/timeoutWait pacing) are compared to the files in
+// golden/. Differences are reported as hex diffs.
+//
+//     pio run -e golden_native -t exec                 compare
+//     pio run -e golden_native -t exec -a --update     rewrite the golden files
+#include <Arduino.h>
+#include <DataMatrix.h>
+#include <PrintScheduler.h>
+#include <ReceiptTemplate.h>
+#include <ThermalPrinter.h>
+#include <fstream>
+#include <functional>
+#include <vector>
+
+namespace {
+
+// Records every byte with the virtual time it was written at. Answers status
+// requests with canned responses and echoes serial echo probes.
+class CaptureStream : public Stream {
+public:
+    static constexpr uint32_t latency = 300;
+
+    void start() {
+        origin = micros();
+        lines.clear();
+        lineTime = 0;
+        count = 0;
+    }
+
+    // answer for the next status request
+    void answerStatus(std::vector<uint8_t> answer) { answers.push_back(std::move(answer)); }
+
+    // transfer time per byte and a link at the wrong rate, which inverts every echoed byte
+    void setLink(uint32_t byteTime, bool garbled) {
+        wireTime = byteTime;
+        this->garbled = garbled;
+    }
+
+    size_t write(uint8_t c) override {
+        const uint32_t t = micros() - origin;
+        delayMicroseconds(wireTime);
+        if(escape == 'n') {
+            reply({uint8_t(garbled ? ~c : c)});
+            escape = 0;
+        } else if(escape == 0x1B && c == 'k' && !answers.empty()) {
+            reply(answers.front());
+            answers.erase(answers.begin());
+            escape = 0;
+        } else {
+            escape = (escape == 0x1B && c == 'n') ? 'n' : c;
+        }
+
+        // one line per burst of bytes sent at the same time
+        if(lines.empty() || t != lineTime || count == 32) {
+            char stamp[16];
+            snprintf(stamp, sizeof(stamp), "@%lu", (unsigned long)t);
+            lines.push_back(stamp);
+            lineTime = t;
+            count = 0;
+        }
+        char hex[4];
+        snprintf(hex, sizeof(hex), " %02X", c);
+        lines.back() += hex;
+        count++;
+        return 1;
+    }
+
+    // room of a UART FIFO, it never fills up as sending takes no time
+    int availableForWrite() override { return 32; }
+
+    int available() override {
+        const auto ready = [&](const Answer &a) { return micros() - origin >= a.readyAt; };
+        return std::find_if_not(response.begin(), response.end(), ready) - response.begin();
+    }
+    int read() override {
+        if(!available())
+            return -1;
+        const uint8_t c = response.front().c;
+        response.erase(response.begin());
+        return c;
+    }
+    int peek() override { return available() ? response.front().c : -1; }
+
+    void note(const std::string &text) {
+        lines.push_back("= " + text);
+        count = 32;
+    }
+
+    // time at which the printer is ready for the next command
+    void idle() {
+        char stamp[24];
+        snprintf(stamp, sizeof(stamp), "@%lu idle", (unsigned long)(micros() - origin));
+        lines.push_back(stamp);
+        count = 32;
+    }
+
+    const std::vector<std::string> &result() const { return lines; }
+
+private:
+    uint32_t origin{0};
+    std::vector<std::string> lines;
+    uint32_t lineTime{0};
+    size_t count{0};
+
+    std::vector<std::vector<uint8_t>> answers;
+    struct Answer {
+        uint8_t c;
+        uint32_t readyAt;
+    };
+    std::vector<Answer> response;
+    uint8_t escape{0};
+    uint32_t wireTime{0};
+    bool garbled{false};
+
+    void reply(const std::vector<uint8_t> &answer) {
+        for(const uint8_t c : answer)
+            response.push_back({c, micros() - origin + latency});
+    }
+};
+
+// 5x5 test font with a space, 'A' and a kerning pair
+constexpr uint8_t fontBitmap[] = {0x20, 0x50, 0x88, 0xF8, 0x88};
+constexpr raster::Glyph fontGlyphs[] = {{0x20, 0, 0, 0, 0, 0, 6}, {0x41, 0, 5, 5, 0, -5, 6}};
+constexpr raster::KerningPair fontKerning[] = {{0x41, 0x41, -1}};
+constexpr raster::Font font = {7, 5, 2, 1, fontGlyphs, fontBitmap, fontKerning};
+
+// 16x4 checkerboard and a fully black line
+constexpr uint8_t bitmap[] = {0xF0, 0x0F, 0xF0, 0x0F, 0x0F, 0xF0, 0x0F, 0xF0};
+const std::vector<uint8_t> blackLine(raster::lineBytes, 0xFF);
+
+constexpr uint8_t tiffData[] = {0xD3, 0x00, 0x01, 0xFF, 0x81, 0xFD, 0xAA, 0xD3, 0xF0};
+constexpr ThermalPrinter::tiffRaw<3> tiff{{2, 5, 2}, tiffData};
+
+struct Case {
+    const char *name;
+    std::function<void(ThermalPrinter &, CaptureStream &)> run;
+};
+
+std::string describe(const ThermalPrinter::Status &s) {
+    char text[96];
+    snprintf(text, sizeof(text), "valid %d paper %d busy %d bufferFull %d overheated %d fill %d temperature %d", s.valid, s.paper, s.busy, s.bufferFull,
+        s.overheated, s.bufferFill ? *s.bufferFill : -1, s.temperature ? *s.temperature : -128);
+    return text;
+}
+
+const Case cases[] = {
+    {"begin", [](ThermalPrinter &p, CaptureStream &) { p.begin(); }},
+    {"reset", [](ThermalPrinter &p, CaptureStream &) { p.reset(); }},
+    {"setBold", [](ThermalPrinter &p, CaptureStream &) {
+         p.setBold(true);
+         p.print("on");
+         p.setBold(false);
+         p.print("off\n");
+     }},
+    {"setUnderline", [](ThermalPrinter &p, CaptureStream &) {
+         p.setUnderline(true);
+         p.print("on");
+         p.setUnderline(false);
+         p.print("off\n");
+     }},
+    {"setInverse", [](ThermalPrinter &p, CaptureStream &) {
+         p.setInverse(true);
+         p.print("on");
+         p.setInverse(false);
+         p.print("off\n");
+     }},
+    {"setUpsideDown", [](ThermalPrinter &p, CaptureStream &) {
+         p.setUpsideDown(true);
+         p.print("on");
+         p.setUpsideDown(false);
+         p.print("off\n");
+     }},
+    {"setHeightZoom", [](ThermalPrinter &p, CaptureStream &) {
+         p.setHeightZoom(ThermalPrinter::ZoomLevel::eightfold);
+         p.print("x\n");
+         p.setHeightZoom(ThermalPrinter::ZoomLevel::single);
+     }},
+    {"setDoubleWidth", [](ThermalPrinter &p, CaptureStream &) {
+         p.setDoubleWidth(true);
+         p.print("on");
+         p.setDoubleWidth(false);
+         p.print("off\n");
+     }},
+    {"setFont", [](ThermalPrinter &p, CaptureStream &) {
+         p.setFont(2);
+         p.print("2");
+         p.setFont(9);
+         p.print("4\n");
+     }},
+    {"setCharSpacing", [](ThermalPrinter &p, CaptureStream &) {
+         p.setCharSpacing(3);
+         p.print("3");
+         p.setCharSpacing(40);
+         p.print("15");
+         p.setCharSpacing();
+         p.print("0\n");
+     }},
+    {"styleCoalescing", [](ThermalPrinter &p, CaptureStream &) {
+         p.setBold(true);
+         p.setBold(false);
+         p.setFont(0);
+         p.setInverse(true);
+         p.setUnderline(true);
+         p.print("A");
+         p.setInverse(true);
+         p.setUnderline(false);
+         p.setUnderline(true);
+         p.print("B\n");
+     }},
+    {"print", [](ThermalPrinter &p, CaptureStream &) { p.print("Hello\r\nWorld\n"); }},
+    {"printf", [](ThermalPrinter &p, CaptureStream &) { p.printf("Total %5.2f\n", 27.35); }},
+    {"tab", [](ThermalPrinter &p, CaptureStream &) { p.tab(); }},
+    {"feed", [](ThermalPrinter &p, CaptureStream &) { p.feed(3); }},
+    {"printWrapped", [](ThermalPrinter &p, CaptureStream &c) {
+         p.print("open line");
+         p.printWrapped("The quick brown fox jumps over the lazy dog near the riverbank\nThanks!", raster::Align::center);
+         p.printWrapped("Supercalifragilisticexpialidocious-and-more", raster::Align::right);
+         p.setDoubleWidth(true);
+         p.printWrapped("Double width text wraps earlier");
+         c.note(std::to_string(p.getColumns()) + " columns");
+     }},
+    {"printColumns", [](ThermalPrinter &p, CaptureStream &) {
+         p.printColumns("Coffee", "2.50");
+         p.printColumns("Chocolate cake with whipped cream and berries", "12.90", ' ');
+         p.printColumns("Exactly twenty-eight chars..", "9.99");
+     }},
+    {"tabAndColumn", [](ThermalPrinter &p, CaptureStream &c) {
+         p.print("ab");
+         p.tab();
+         c.note(std::to_string(p.getColumn()));
+         p.setAbsoluteCursor(uint16_t(120));
+         c.note(std::to_string(p.getColumn()));
+         p.print("\n");
+         c.note(std::to_string(p.getColumn()));
+     }},
+    {"printTextSuperPosition", [](ThermalPrinter &p, CaptureStream &c) {
+         p.print("VOID");
+         p.printTextSuperPosition("----");
+         p.setDoubleWidth(true);
+         c.note(p.printTextSuperPosition("more than twelve") ? "printed" : "too long");
+     }},
+    {"printBarcode_doubleWidth", [](ThermalPrinter &p, CaptureStream &) {
+         // the text below is centered with the wide characters
+         p.setDoubleWidth(true);
+         p.printBarcode("123ABC", ThermalPrinter::BarcodeType::CODE39);
+     }},
+    {"feedPixel", [](ThermalPrinter &p, CaptureStream &) {
+         p.feedPixel(12);
+         p.feedPixel(300);
+     }},
+    {"setAbsoluteCursor", [](ThermalPrinter &p, CaptureStream &) {
+         p.setAbsoluteCursor(uint8_t(5));
+         p.setAbsoluteCursor(uint16_t(300));
+     }},
+    {"clearBuffer", [](ThermalPrinter &p, CaptureStream &) { p.clearBuffer(); }},
+    {"setGraphicEncoding", [](ThermalPrinter &p, CaptureStream &) {
+         p.setGraphicEncoding(ThermalPrinter::GraphicEncoding::tiff);
+         p.setGraphicEncoding(ThermalPrinter::GraphicEncoding::uncompressed);
+     }},
+    {"printBarcode_code39", [](ThermalPrinter &p, CaptureStream &) { p.printBarcode("123ABC", ThermalPrinter::BarcodeType::CODE39); }},
+    {"printBarcode_itf", [](ThermalPrinter &p, CaptureStream &) { p.printBarcode("12345678", ThermalPrinter::BarcodeType::ITF); }},
+    {"printBarcode_ean13", [](ThermalPrinter &p, CaptureStream &) { p.printBarcode("400638133393", ThermalPrinter::BarcodeType::EAN13); }},
+    {"printBarcode_ean8", [](ThermalPrinter &p, CaptureStream &) {
+         p.setBarcodeHeight(40);
+         p.setBarcodeWithText(false);
+         p.printBarcode("9638507", ThermalPrinter::BarcodeType::EAN8);
+     }},
+    {"printBarcode_code128", [](ThermalPrinter &p, CaptureStream &) {
+         p.setBarcodeHeight(8);
+         p.printBarcode("ACME-0042", raster::Symbology::code128);
+     }},
+    {"printBarcode_upca", [](ThermalPrinter &p, CaptureStream &) {
+         p.setBarcodeHeight(4);
+         p.setBarcodeWithText(false);
+         p.printBarcode("03600029145", raster::Symbology::upca);
+     }},
+    {"printBarcode_invalid", [](ThermalPrinter &p, CaptureStream &) { p.printBarcode("ABC", raster::Symbology::ean13); }},
+    {"printQrCode", [](ThermalPrinter &p, CaptureStream &) { p.printQrCode("Hello World", 8); }},
+    {"printQrCode_autoZoom", [](ThermalPrinter &p, CaptureStream &) { p.printQrCode("https://example.com/r/0042"); }},
+    {"printQrCode_tooLarge", [](ThermalPrinter &p, CaptureStream &) { p.printQrCode("Hello World", 50); }},
+    {"printDataMatrix", [](ThermalPrinter &p, CaptureStream &) { p.printDataMatrix("123456", 6); }},
+    {"printMatrix", [](ThermalPrinter &p, CaptureStream &) {
+         raster::Matrix m(3, 2);
+         m.setModule(0, 0, true);
+         m.setModule(2, 1, true);
+         p.printMatrix(m, 4, 1);
+     }},
+    {"printBitmap", [](ThermalPrinter &p, CaptureStream &) { p.printBitmap(16, 4, bitmap); }},
+    {"printBitmap_heatBudget", [](ThermalPrinter &p, CaptureStream &) {
+         p.printBitmap(raster::pxLine, 1, blackLine.data());
+         p.setHeatBudget(0);
+         p.printBitmap(raster::pxLine, 1, blackLine.data());
+     }},
+    {"printTiff", [](ThermalPrinter &p, CaptureStream &) { p.printTiff(tiff); }},
+    {"printBand", [](ThermalPrinter &p, CaptureStream &) {
+         raster::Band band(6);
+         band.fillRect(10, 0, 20, 1);
+         band.fillRect(0, 4, 384, 2);
+         p.printBand(band);
+     }},
+    {"printText", [](ThermalPrinter &p, CaptureStream &) {
+         p.printText(font, "AA A", raster::Align::center);
+         p.setCharSpacing(2);
+         p.printText(font, "A\nA", raster::Align::right);
+     }},
+    {"printUtf8", [](ThermalPrinter &p, CaptureStream &) {
+         p.printUtf8("Gr\u00FC\u00DFe \u2500\u2500 5\u20AC\n");
+         p.setCodePage(codepage::CodePage::cp858);
+         p.printUtf8("5\u20AC \xFF\n");
+         p.setCodePage(codepage::CodePage::cp437);
+         p.setFallbackFont(&font);
+         p.printUtf8("A\u20AC\nA");
+     }},
+    {"receiptTemplate", [](ThermalPrinter &p, CaptureStream &c) {
+         ReceiptTemplate bad;
+         c.note(bad.compile("@center\n@bold maybe\n") ? "compiled" : "error in line " + std::to_string(bad.errorLine()));
+
+         ReceiptTemplate receipt;
+         receipt.compile("# shop header\n"
+                         "@center\n"
+                         "@bold on\n"
+                         "ACME {branch}\n"
+                         "@bold off\n"
+                         "Receipt {number}\n"
+                         "@left\n"
+                         "@items\n"
+                         "@columns {qty}x {item} | {price}\n"
+                         "@end\n"
+                         "@columns Total | {total}\n"
+                         "@qr 2 HELLO\n"
+                         "@qr auto {url}\n"
+                         "@feed 40\n"
+                         "@cut\n");
+         c.note(std::to_string(receipt.slotCount()) + " slots");
+
+         static const char *const names[] = {"Coffee", "Cake"};
+         ReceiptTemplate::Values values;
+         values.set(receipt.slot("branch"), "Main St");
+         values.set(receipt.slot("number"), 42);
+         values.set(receipt.slot("total"), 6.4);
+         values.set(receipt.slot("url"), "https://example.com/r/7");
+         const int slots[] = {receipt.slot("qty"), receipt.slot("item"), receipt.slot("price")};
+         receipt.render(p, values, 2, [](size_t item, ReceiptTemplate::Values &v, void *context) {
+             const int *s = static_cast<const int *>(context);
+             v.set(s[0], int(item) + 1);
+             v.set(s[1], names[item]);
+             v.set(s[2], 2.5 + item * 1.4);
+         }, const_cast<int *>(slots));
+
+         // a payload too long for any QR code leaves the field out
+         ReceiptTemplate qr;
+         qr.compile("@qr auto {data}\nafter\n");
+         const std::string tooLong(8000, 'x');
+         ReceiptTemplate::Values data;
+         data.set(qr.slot("data"), tooLong.c_str());
+         qr.render(p, data);
+     }},
+    {"getStatus", [](ThermalPrinter &p, CaptureStream &c) {
+         c.answerStatus({0x03});
+         c.answerStatus({0x8C, 95, 61});
+         c.note(describe(p.getStatus()));
+         c.note(describe(p.getStatus()));
+         c.note(describe(p.getStatus()));
+         c.note(p.hasPaper() ? "hasPaper" : "no paper");
+     }},
+    {"echoLatency", [](ThermalPrinter &p, CaptureStream &c) { c.note(std::to_string(p.echoLatency(0x42))); }},
+    {"setPacing_status", [](ThermalPrinter &p, CaptureStream &c) {
+         c.answerStatus({0x00});
+         c.answerStatus({0x04});
+         c.answerStatus({0x04});
+         c.answerStatus({0x02});
+         p.setPacing(ThermalPrinter::Pacing::status, 100);
+         p.printBitmap(16, 4, bitmap);
+         p.print("after drain\n");
+         p.printBitmap(16, 4, bitmap);
+     }},
+    {"printQrCode_zoom0", [](ThermalPrinter &p, CaptureStream &c) {
+         // zoom 0 prints at module size 1 like the Compositor
+         c.note(p.printQrCode("0", 0) ? "printed" : "rejected");
+     }},
+    {"batchEncoding", [](ThermalPrinter &p, CaptureStream &c) {
+         // the tiff encoding is already active, the batch still has to select it
+         p.printTiff(tiff);
+         const ThermalPrinter::Batch graphic = p.recordBatch([&] { p.printTiff(tiff); });
+         c.note("recorded " + std::to_string(graphic.data.size()) + " bytes");
+         p.uploadBatch(graphic);
+         p.runBatch();
+     }},
+    {"batchLabelFeed", [](ThermalPrinter &p, CaptureStream &c) {
+         p.beginLabels(240);
+         p.print("Label 1\n");
+         p.nextLabel();
+         // the pending feed to the next label stays in the live output
+         const ThermalPrinter::Batch header = p.recordBatch([&] { p.print("Header\n"); });
+         c.note("recorded " + std::to_string(header.data.size()) + " bytes, " + std::to_string(header.duration) + " us, label position " +
+             std::to_string(p.getLabelPosition()));
+         p.print("Label 2\n");
+     }},
+    {"linkNegotiation", [](ThermalPrinter &p, CaptureStream &c) {
+         // a printer fixed at 230400 baud, faster rates garble its answers
+         const ThermalPrinter::LinkSpeed link = p.begin(
+             [](uint32_t baud, void *context) { static_cast<CaptureStream *>(context)->setLink(10000000 / baud, baud != 230400); }, &c);
+         c.note(std::to_string(link.baud) + " baud, " + std::to_string(link.roundTrip) + " us round trip, " + std::to_string(link.bytesPerSecond) +
+             " bytes/s, byte time " + std::to_string(p.getByteTime()));
+         p.print("fast\n");
+     }},
+    {"batch", [](ThermalPrinter &p, CaptureStream &c) {
+         c.note(p.runBatch() ? "ran" : "no batch");
+         const ThermalPrinter::Batch header = p.recordBatch([&] {
+             p.setBold(true);
+             p.print("ACME\n");
+             p.setBold(false);
+             p.printBitmap(16, 2, bitmap);
+         });
+         c.note("recorded " + std::to_string(header.data.size()) + " bytes, " + std::to_string(header.duration) + " us");
+         c.note(p.uploadBatch(header) ? "uploaded" : "rejected");
+         p.runBatch();
+         p.print("Receipt 1\n");
+         p.runBatch();
+         p.setBatchCapacity(16);
+         c.note(p.uploadBatch(header) ? "uploaded" : "rejected");
+     }},
+    {"scheduler", [](ThermalPrinter &p, CaptureStream &c) {
+         CaptureStream c2;
+         ThermalPrinter p2(c2);
+         c2.start();
+         PrintScheduler scheduler;
+         const size_t first = scheduler.addPrinter(p);
+         const size_t second = scheduler.addPrinter(p2);
+         scheduler.submit(first, p.recordBatch([&] {
+             p.setBold(true);
+             p.print("one\n");
+             p.printBitmap(16, 2, bitmap);
+         }));
+         scheduler.submit(second, p2.recordBatch([&] {
+             p2.printBitmap(16, 2, bitmap);
+             p2.print("two\n");
+         }));
+         scheduler.submit(first, p.recordBatch([&] { p.feedPixel(30); }));
+         for(uint32_t wait; (wait = scheduler.poll()) != UINT32_MAX;)
+             delayMicroseconds(wait);
+         c.note(scheduler.isIdle() ? "idle" : "busy");
+         // the job left bold on
+         p.print("plain\n");
+         for(const std::string &line : c2.result())
+             c.note("second " + line);
+         for(const size_t channel : {first, second}) {
+             const PrintScheduler::Stats &s = scheduler.getStats(channel);
+             c.note(std::to_string(s.jobs) + " jobs, " + std::to_string(s.bytes) + " bytes, " + std::to_string(s.lateTime) + " us late, " +
+                 std::to_string(s.stalls) + " stalls");
+         }
+     }},
+    {"setPacing_status_barcode", [](ThermalPrinter &p, CaptureStream &c) {
+         // the barcode text must not be split by a status request
+         c.answerStatus({0x00});
+         c.answerStatus({0x00});
+         p.setPacing(ThermalPrinter::Pacing::status, 10);
+         p.print("code\n");
+         p.printBarcode("123ABC", ThermalPrinter::BarcodeType::CODE39);
+         p.print("done\n");
+     }},
+    {"writeRaw", [](ThermalPrinter &p, CaptureStream &c) {
+         const auto raw = [&](std::vector<uint8_t> data) { p.writeRaw(data.data(), data.size()); };
+         // a newline is paced like print() at the zoom the stream set
+         raw({'a', '\n', 0x1B, 'H', 0x01, 'b', '\n'});
+         raw({0x1B, 'F', 0x00, 0x10});
+         // a job cut off inside a graphic line
+         raw({0x1B, 'm', 0x00, 0x1B, 'g', 0x33, 0xFF, 0xFF});
+         p.endRaw();
+         c.answerStatus({0x00});
+         c.answerStatus({0x00});
+         c.answerStatus({0x00});
+         p.setPacing(ThermalPrinter::Pacing::status, 8);
+         // the next job is parsed from its first byte, status polls work again
+         raw({'n', 'e', 'x', 't', '\n'});
+         raw({'j', 'o', 'b', '\n'});
+         raw({'o', 'k', '\n'});
+     }},
+    {"setPacing_bufferStuck", [](ThermalPrinter &p, CaptureStream &c) {
+         // e.g. out of paper, the printer keeps reporting a full buffer
+         for(int i = 0; i < 400; i++)
+             c.answerStatus({0x04});
+         p.setPacing(ThermalPrinter::Pacing::status, 100);
+         p.printBitmap(16, 4, bitmap);
+         c.note("gave up waiting");
+     }},
+    {"setPacing_noAnswer", [](ThermalPrinter &p, CaptureStream &c) {
+         p.setPacing(ThermalPrinter::Pacing::status, 100);
+         // paced by the timing model after the first request went unanswered
+         p.printBitmap(16, 4, bitmap);
+         // back to status pacing once the printer answers again
+         c.answerStatus({0x00});
+         p.printBitmap(16, 4, bitmap);
+     }},
+    {"labels", [](ThermalPrinter &p, CaptureStream &c) {
+         p.beginLabels(240, 8);
+         p.print("Label 1\n");
+         p.feedPixel(10);
+         p.setBold(true);
+         p.feedPixel(20);
+         p.printBitmap(16, 2, bitmap);
+         c.note(std::to_string(p.getLabelPosition()));
+         p.setLabelPosition(0);
+         p.print("Top\n");
+         p.nextLabel();
+         p.nextLabel();
+         p.print("Label 2\n");
+         p.endLabels(40);
+         p.beginLabels(240, 8);
+         p.print("Label 3\n");
+         p.cutPaper();
+     }},
+};
+
+std::vector<std::string> readGolden(const std::string &path) {
+    std::vector<std::string> lines;
+    std::ifstream in(path);
+    for(std::string line; std::getline(in, line);)
+        if(!line.empty() && line[0] != '#')
+            lines.push_back(line);
+    return lines;
+}
+
+void writeGolden(const std::string &path, const char *name, const std::vector<std::string> &lines) {
+    std::ofstream out(path);
+    out << "# " << name << ": @<virtual time in us> <bytes sent>\n";
+    for(const std::string &line : lines)
+        out << line << '\n';
+}
+
+void printDiff(const std::vector<std::string> &expected, const std::vector<std::string> &actual) {
+    constexpr size_t maxShown = 8;
+    size_t shown = 0;
+    size_t differing = 0;
+    for(size_t i = 0; i < std::max(expected.size(), actual.size()); i++) {
+        const std::string e = i < expected.size() ? expected[i] : "(none)";
+        const std::string a = i < actual.size() ? actual[i] : "(none)";
+        if(e == a)
+            continue;
+        differing++;
+        if(shown++ < maxShown)
+            printf("  line %zu\n    - %s\n    + %s\n", i + 1, e.c_str(), a.c_str());
+    }
+    if(differing > maxShown)
+        printf("  ... %zu more differing lines\n", differing - maxShown);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    bool update = false;
+    std::string dir = "golden";
+    for(int i = 1; i < argc; i++) {
+        if(std::string(argv[i]) == "--update")
+            update = true;
+        else
+            dir = argv[i];
+    }
+
+    size_t failed = 0;
+    for(const Case &c : cases) {
+        CaptureStream capture;
+        ThermalPrinter printer(capture);
+        host::now = 0;
+        capture.start();
+        c.run(printer, capture);
+        printer.timeoutWait();
+        capture.idle();
+
+        const std::string path = dir + "/" + c.name + ".hex";
+        if(update) {
+            writeGolden(path, c.name, capture.result());
+            continue;
+        }
+        const std::vector<std::string> expected = readGolden(path);
+        if(expected == capture.result())
+            continue;
+        failed++;
+        printf("FAIL %s (%s)\n", c.name, path.c_str());
+        printDiff(expected, capture.result());
+    }
+
+    if(update) {
+        printf("updated %zu golden files in %s\n", std::size(cases), dir.c_str());
+        return 0;
+    }
+    printf("%zu of %zu cases passed\n", std::size(cases) - failed, std::size(cases));
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+// Minimal host implementation of the Arduino API used by the library, for the
+// native environments. Time is virtual: it only advances in yield() and delay(),
+// so pacing is deterministic and a wait costs no real time.
+
+#include <algorithm>
+#include <cctype>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+namespace host {
+inline uint32_t now{0};
+} // namespace host
+
+inline uint32_t micros() { return host::now; }
+inline uint32_t millis() { return host::now / 1000; }
+inline void yield() { host::now++; }
+inline void delayMicroseconds(uint32_t us) { host::now += us; }
+inline void delay(uint32_t ms) { host::now += ms * 1000; }
+
+class String {
+public:
+    String(const char *s = "") : str{s} { }
+    const char *c_str() const { return str.c_str(); }
+    size_t length() const { return str.size(); }
+
+private:
+    std::string str;
+};
+
+class Print {
+public:
+    virtual ~Print() = default;
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+        size_t n = 0;
+        while(size--)
+            n += write(*buffer++);
+        return n;
+    }
+    size_t write(const char *s) { return write(reinterpret_cast<const uint8_t *>(s), strlen(s)); }
+    size_t write(const char *buffer, size_t size) { return write(reinterpret_cast<const uint8_t *>(buffer), size); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() { }
+
+    size_t print(const char *s) { return write(s); }
+    size_t print(char c) { return write(uint8_t(c)); }
+    size_t print(const String &s) { return write(s.c_str()); }
+    size_t print(int v) { return printf("%d", v); }
+    size_t print(unsigned v) { return printf("%u", v); }
+    size_t print(long v) { return printf("%ld", v); }
+    size_t print(unsigned long v) { return printf("%lu", v); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(T v) { return print(v) + println(); }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3))) {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        const int len = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        return write(buffer, std::min<size_t>(std::max(len, 0), sizeof(buffer) - 1));
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long ms) { timeout = ms; }
+
+    size_t readBytes(uint8_t *buffer, size_t length) {
+        size_t count = 0;
+        const uint32_t start = millis();
+        while(count < length && millis() - start < timeout) {
+            const int c = read();
+            if(c < 0) {
+                yield();
+                continue;
+            }
+            buffer[count++] = c;
+        }
+        return count;
+    }
+    size_t readBytes(char *buffer, size_t length) { return readBytes(reinterpret_cast<uint8_t *>(buffer), length); }
+
+protected:
+    unsigned long timeout{1000};
+};
@@ -1,9 +1,38 @@
 #include <Arduino.h>
 #include <ThermalPrinter.h>
 
+#include "PioUart.h"
+#include "PrintServer.h"
+#include "UartBridge.h"
 #include "images.h"
 
+// raw jobs over TCP port 9100 on a Pico W, build with -DWIFI_SSID=... -DWIFI_PASSWORD=...
+#if defined(ARDUINO_RASPBERRY_PI_PICO_W) && defined(WIFI_SSID)
+#define PRINTSERVER_WIFI
+#include <WiFi.h>
+WiFiServer tcpServer(9100);
+WiFiClient tcpClient;
+#endif
+
 ThermalPrinter printer(Serial1);
+// transparent pass through for PC driven printing instead of the print server
+#ifdef BRIDGE_MODE
+UartBridge bridge(Serial, Serial1);
+#else
+PrintServer server(printer, Serial1);
+#endif
+// second printer on a PIO UART, build with -DPIO_PRINTER_TX=<pin> and optionally
+// -DPIO_PRINTER_CTS=<pin> -DPIO_PRINTER_BAUD=<rate>
+#ifdef PIO_PRINTER_TX
+#ifndef PIO_PRINTER_CTS
+#define PIO_PRINTER_CTS PioUart::noPin
+#endif
+#ifndef PIO_PRINTER_BAUD
+#define PIO_PRINTER_BAUD 115200
+#endif
+PioUart pioUart(PIO_PRINTER_TX, PIO_PRINTER_CTS);
+ThermalPrinter printer2(pioUart);
+#endif
 
 void setup() {
     Serial.begin(115200);
@@ -14,6 +43,12 @@ void setup() {
     Serial1.begin();
 
     printer.begin();
+#ifdef PIO_PRINTER_TX
+    if(pioUart.begin(PIO_PRINTER_BAUD)) {
+        printer2.begin();
+        printer2.println("Hello PIO UART");
+    }
+#endif
 
     printer.println("Hello World");
     // printer.printBinaryFile(aws_root_ca_pem_start, aws_root_ca_pem_end-aws_root_ca_pem_start);
@@ -34,28 +69,28 @@ void setup() {
     }
     printer.println();
     delay(100);
+
+#ifdef PRINTSERVER_WIFI
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    tcpServer.begin();
+#endif
 }
 
 void loop() {
-
-    size_t count = Serial.available();
-    while(count--){
-        const char c = Serial.read();
-        Serial1.print(c);
+#ifdef BRIDGE_MODE
+    bridge.poll();
+#else
+#ifdef PRINTSERVER_WIFI
+    if(!tcpClient.connected()) {
+        // a closed connection ends its job
+        server.endJob();
+        tcpClient = tcpServer.accept();
     }
-    count = Serial1.available();
-    while(count--) {
-        const char c = Serial1.read();
-        Serial.print(c);
+    if(tcpClient) {
+        server.poll(tcpClient);
+        return;
     }
-
-    // while(Serial2.available()) {
-    //     int c = Serial2.read();
-    //     Serial.printf("%c (0x%02x) | ", c, c);
-    // }
-    // static uint32_t lastPrint = millis();
-    // if((millis() - lastPrint) > 10000) {
-    //     // log_d("alive");
-    //     lastPrint = millis();
-    // }
-}
\ No newline at end of file
+#endif
+    server.poll(Serial);
+#endif
+}
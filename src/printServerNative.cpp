@@ -0,0 +1,120 @@
+// Host stand-in of the print server, built by the "printserver_native"
+// environment. Listens on a localhost TCP port like a printer's raw port 9100
+// and writes what the printer would receive to a capture file, which
+// tools/printerEmulator.py turns into a picture of the receipt:
+//
+//     pio run -e printserver_native -t exec -a "9100 capture.bin"
+//     nc -q1 localhost 9100 < job.bin
+//     printerEmulator.py capture.bin --png out.png
+#include "PrintServer.h"
+#include <Arduino.h>
+#include <ThermalPrinter.h>
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+// connected TCP client
+class SocketStream : public Stream {
+public:
+    explicit SocketStream(int fd) : fd{fd} { }
+    ~SocketStream() override { close(fd); }
+
+    int available() override {
+        int n = 0;
+        return ioctl(fd, FIONREAD, &n) == 0 ? n : 0;
+    }
+    int read() override {
+        uint8_t c;
+        return recv(fd, &c, 1, MSG_DONTWAIT) == 1 ? c : -1;
+    }
+    int peek() override {
+        uint8_t c;
+        return recv(fd, &c, 1, MSG_DONTWAIT | MSG_PEEK) == 1 ? c : -1;
+    }
+    size_t write(uint8_t c) override { return send(fd, &c, 1, MSG_NOSIGNAL) == 1; }
+
+    bool connected() {
+        uint8_t c;
+        return recv(fd, &c, 1, MSG_DONTWAIT | MSG_PEEK) != 0;
+    }
+
+private:
+    int fd;
+};
+
+// the printer side, everything sent to it goes into a file
+class CaptureFile : public Stream {
+public:
+    explicit CaptureFile(const char *path) : file{fopen(path, "wb")} { }
+    ~CaptureFile() override {
+        if(file)
+            fclose(file);
+    }
+
+    bool isOpen() const { return file != nullptr; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    size_t write(uint8_t c) override { return fputc(c, file) != EOF; }
+    size_t write(const uint8_t *buffer, size_t size) override { return fwrite(buffer, 1, size, file); }
+    void flush() override { fflush(file); }
+
+private:
+    FILE *file;
+};
+
+int listenOn(uint16_t port) {
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    const int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(fd, 1) != 0) {
+        perror("listen");
+        exit(1);
+    }
+    return fd;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    const uint16_t port = (argc > 1) ? atoi(argv[1]) : 9100;
+    CaptureFile capture((argc > 2) ? argv[2] : "capture.bin");
+    if(!capture.isOpen()) {
+        perror("capture file");
+        return 1;
+    }
+
+    ThermalPrinter printer(capture);
+    PrintServer server(printer, capture);
+    const int listener = listenOn(port);
+    printf("print server on localhost:%u\n", port);
+    fflush(stdout);
+
+    for(;;) {
+        SocketStream client(accept(listener, nullptr, nullptr));
+        while(client.connected() || client.available() > 0) {
+            server.poll(client);
+            if(printer.isBusy()) {
+                delayMicroseconds(50);
+            } else {
+                // idle, let the virtual clock follow the real one
+                usleep(1000);
+                delay(1);
+            }
+        }
+        server.endJob();
+        const PrintServer::Stats &s = server.getStats();
+        printf("jobs %lu, bytes %lu, blocks %lu, stalls %lu\n", (unsigned long)s.jobs, (unsigned long)s.bytes, (unsigned long)s.blocks,
+            (unsigned long)s.stalls);
+        fflush(stdout);
+    }
+}
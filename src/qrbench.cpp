@@ -0,0 +1,174 @@
+// QR encoder microbenchmark, built by the "qrbench" environment (RP2040, CPU
+// cycles over Serial) and by "qrbench_native" (host, nanoseconds on stdout).
+// Times encodeText, encodeBinary and encodeSegments for every version and ECC
+// level with the largest byte payload the symbol holds, plus the payloads we
+// actually print, and splits the time into the stages of qrcodegen::Profile.
+// The receipt payloads come first, the sweep is dominated by the large
+// versions and runs for a long while on the RP2040.
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <chrono>
+#include <cstdio>
+#endif
+#include <QrCodeGen.hpp>
+#include <algorithm>
+#include <cstdarg>
+#include <cstring>
+#include <vector>
+
+#ifndef QRCODEGEN_PROFILE
+#error "qrbench needs the encoder built with -DQRCODEGEN_PROFILE"
+#endif
+
+using qrcodegen::Profile;
+using qrcodegen::QrCode;
+using qrcodegen::QrSegment;
+
+#ifdef ARDUINO
+static constexpr size_t runs = 3;
+static constexpr const char *unit = "cycles";
+static uint32_t clockNow() { return rp2040.getCycleCount(); }
+#else
+static constexpr size_t runs = 25;
+static constexpr const char *unit = "ns";
+static uint32_t clockNow() {
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+#endif
+
+static void output(const char *format, ...) {
+    char line[512];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+#ifdef ARDUINO
+    Serial.println(line);
+#else
+    puts(line);
+#endif
+}
+
+static constexpr QrCode::Ecc eccLevels[] = {QrCode::Ecc::ECC_LOW, QrCode::Ecc::ECC_MEDIUM, QrCode::Ecc::ECC_QUARTILE, QrCode::Ecc::ECC_HIGH};
+static constexpr const char *eccNames[] = {"L", "M", "Q", "H"};
+
+/**
+ * Run encode() a few times and print min, median and mean of the total time
+ * together with the mean time of every encoder stage.
+ */
+template <typename F> static void measure(const char *fn, const char *payload, size_t ecc, size_t bytes, F encode) {
+    uint32_t totals[runs];
+    uint64_t stages[Profile::STAGE_COUNT]{};
+    int version = 0;
+
+    encode(); // warm up the heap
+    for(size_t i = 0; i < runs; i++) {
+        Profile::reset();
+        const uint32_t start = clockNow();
+        const QrCode qr = encode();
+        totals[i] = clockNow() - start;
+        version = qr.getVersion();
+        for(size_t s = 0; s < Profile::STAGE_COUNT; s++)
+            stages[s] += Profile::total[s];
+    }
+
+    std::sort(totals, totals + runs);
+    uint64_t sum = 0;
+    for(uint32_t t : totals)
+        sum += t;
+
+    char stageJson[256];
+    size_t len = 0;
+    for(size_t s = 0; s < Profile::STAGE_COUNT; s++)
+        len += snprintf(stageJson + len, sizeof(stageJson) - len, ",\"%s\":%lu", Profile::STAGE_NAMES[s], (unsigned long)(stages[s] / runs));
+
+    output("QRBENCH {\"fn\":\"%s\",\"payload\":\"%s\",\"ecc\":\"%s\",\"version\":%d,\"bytes\":%u,\"min\":%lu,\"median\":%lu,\"mean\":%lu%s}", fn, payload,
+        eccNames[ecc], version, (unsigned)bytes, (unsigned long)totals[0], (unsigned long)totals[runs / 2], (unsigned long)(sum / runs), stageJson);
+}
+
+/**
+ * Largest byte mode payload that fits into the given version.
+ */
+static size_t byteCapacity(int version, QrCode::Ecc ecl) {
+    size_t lo = 0;
+    size_t hi = 2953;
+    while(lo < hi) {
+        const size_t mid = (lo + hi + 1) / 2;
+        try {
+            const std::vector<QrSegment> segs{QrSegment::makeBytes(std::vector<uint8_t>(mid))};
+            QrCode::encodeSegments(segs, ecl, version, version, 0, false);
+            lo = mid;
+        } catch(const qrcodegen::data_too_long &) {
+            hi = mid - 1;
+        }
+    }
+    return lo;
+}
+
+static void sweep() {
+    for(size_t e = 0; e < std::size(eccLevels); e++) {
+        const QrCode::Ecc ecl = eccLevels[e];
+        for(int version = QrCode::MIN_VERSION; version <= QrCode::MAX_VERSION; version++) {
+            const size_t bytes = byteCapacity(version, ecl);
+            // lower case letters keep encodeText in byte mode, so all three hit the same version
+            std::vector<uint8_t> data(bytes);
+            for(size_t i = 0; i < bytes; i++)
+                data[i] = 'a' + (i * 7) % 26;
+            std::string text(data.begin(), data.end());
+            const std::vector<QrSegment> segs{QrSegment::makeBytes(data)};
+
+            measure("encodeText", "fill", e, bytes, [&] { return QrCode::encodeText(text.c_str(), ecl); });
+            measure("encodeBinary", "fill", e, bytes, [&] { return QrCode::encodeBinary(data, ecl); });
+            measure("encodeSegments", "fill", e, bytes, [&] { return QrCode::encodeSegments(segs, ecl, version, version); });
+        }
+    }
+}
+
+static void receipts() {
+    static char alnum[1001];
+    for(size_t i = 0; i < sizeof(alnum) - 1; i++)
+        alnum[i] = 'A' + (i * 7) % 26;
+
+    const struct {
+        const char *name;
+        const char *text;
+    } payloads[] = {
+        {"receipt_id", "0042202610190001"},
+        {"payment_url", "https://pay.example.com/r/ACME-0042?amount=27.35&currency=EUR&ref=7f3a9c21"},
+        {"qr_1000", alnum},
+    };
+
+    for(const auto &p : payloads)
+        for(size_t e = 0; e < std::size(eccLevels); e++)
+            measure("encodeText", p.name, e, strlen(p.text), [&] { return QrCode::encodeText(p.text, eccLevels[e]); });
+}
+
+static void run() {
+    Profile::clock = clockNow;
+#ifdef ARDUINO
+    output("QRBENCH {\"unit\":\"%s\",\"runs\":%u,\"f_cpu\":%lu}", unit, (unsigned)runs, (unsigned long)F_CPU);
+#else
+    output("QRBENCH {\"unit\":\"%s\",\"runs\":%u}", unit, (unsigned)runs);
+#endif
+    receipts();
+    sweep();
+    output("QRBENCH {\"done\":true}");
+}
+
+#ifdef ARDUINO
+void setup() {
+    Serial.begin(115200);
+    while(!Serial)
+        delay(10);
+    run();
+}
+
+void loop() { }
+#else
+int main() {
+    run();
+    return 0;
+}
+#endif
@@ -0,0 +1,638 @@
+// Differential fuzzer for the QR encoder, built by the "qrfuzz_native" environment.
+// Every input is turned into text, binary data or a list of segments plus ECC
+// level, version range, mask and boost flag and fed through encodeSegments of
+// both the library encoder and the frozen reference in src/reference. The module
+// grids have to match bit for bit, and the result has to decode back to the
+// input with the independent decoder below (format and version information,
+// function patterns, Reed-Solomon syndromes, segment data and padding).
+//
+// Property test with random inputs after a sweep over all versions, ECC levels
+// and masks:
+//     pio run -e qrfuzz_native -t exec -a "<iterations> <seed>"
+// Coverage guided with libFuzzer:
+//     clang++ -std=gnu++23 -g -O1 -fsanitize=fuzzer,address,undefined -DQRFUZZ_LIBFUZZER
+//         -Ilib/ThermalPrinter/src src/qrfuzz.cpp src/reference/QrReference.cpp lib/ThermalPrinter/src/QrCodeGen.cpp -o qrfuzz
+#include <QrCodeGen.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "reference/QrReference.hpp"
+
+namespace {
+
+struct SegmentSpec {
+    enum Kind : uint8_t { numeric, alphanumeric, bytes, eci, kanji, kindCount };
+    Kind kind;
+    // characters, bytes or big endian 13 bit kanji values
+    std::vector<uint8_t> data;
+    long assignVal;
+
+    bool operator==(const SegmentSpec &) const = default;
+};
+
+struct Case {
+    enum Api : uint8_t { textInput, binaryInput, segmentInput };
+    Api api;
+    int ecl;
+    int minVersion;
+    int maxVersion;
+    int mask;
+    bool boostEcl;
+    std::string text;
+    std::vector<uint8_t> binaryData;
+    std::vector<SegmentSpec> segs;
+};
+
+constexpr const char *alphanumericCharset = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+
+class Reader {
+public:
+    Reader(const uint8_t *data, size_t size) : pos{data}, end{data + size} { }
+
+    bool empty() const { return pos == end; }
+    size_t remaining() const { return end - pos; }
+    uint8_t next() { return empty() ? 0 : *pos++; }
+
+private:
+    const uint8_t *pos;
+    const uint8_t *end;
+};
+
+Case parseCase(const uint8_t *data, size_t size) {
+    Reader in(data, size);
+    Case c{};
+    const uint8_t flags = in.next();
+    c.api = Case::Api(flags % 3);
+    c.ecl = (flags >> 2) & 3;
+    c.boostEcl = flags & 0x10;
+    c.mask = in.next() % 9 - 1;
+    const uint8_t v1 = in.next();
+    const uint8_t v2 = in.next();
+    c.minVersion = 1 + std::min(v1 % 40, v2 % 40);
+    c.maxVersion = 1 + std::max(v1 % 40, v2 % 40);
+    // now and then an invalid range, both encoders have to reject it alike
+    if((v1 & 0x80) && c.minVersion != c.maxVersion)
+        std::swap(c.minVersion, c.maxVersion);
+
+    switch(c.api) {
+    case Case::textInput:
+        while(!in.empty() && c.text.size() < 7089) {
+            const char ch = in.next();
+            if(ch == 0)
+                break;
+            c.text.push_back(ch);
+        }
+        break;
+    case Case::binaryInput:
+        while(!in.empty())
+            c.binaryData.push_back(in.next());
+        break;
+    case Case::segmentInput:
+        while(!in.empty()) {
+            const uint8_t header = in.next();
+            SegmentSpec s{SegmentSpec::Kind(header % SegmentSpec::kindCount), {}, 0};
+            const size_t len = std::min<size_t>(in.next() | (header >> 3) << 8, in.remaining());
+            switch(s.kind) {
+            case SegmentSpec::numeric:
+                for(size_t i = 0; i < len; i++)
+                    s.data.push_back('0' + in.next() % 10);
+                break;
+            case SegmentSpec::alphanumeric:
+                for(size_t i = 0; i < len; i++)
+                    s.data.push_back(alphanumericCharset[in.next() % 45]);
+                break;
+            case SegmentSpec::bytes:
+                for(size_t i = 0; i < len; i++)
+                    s.data.push_back(in.next());
+                break;
+            case SegmentSpec::eci:
+                for(int i = 0; i < 3; i++)
+                    s.assignVal = s.assignVal << 8 | in.next();
+                s.assignVal %= 1000000;
+                break;
+            case SegmentSpec::kanji:
+                for(size_t i = 0; i < len / 2; i++) {
+                    s.data.push_back(in.next() & 0x1F);
+                    s.data.push_back(in.next());
+                }
+                break;
+            default:
+                break;
+            }
+            c.segs.push_back(std::move(s));
+        }
+        break;
+    }
+    return c;
+}
+
+/*---- Encoding with both implementations ----*/
+
+struct Result {
+    enum Error : uint8_t { none, tooLong, invalidArgument, domainError, other };
+    Error error{none};
+    int version{0};
+    int ecl{0};
+    int mask{0};
+    int size{0};
+    std::vector<bool> modules;
+
+    bool operator==(const Result &) const = default;
+};
+
+template <typename Segment> Segment makeSegment(const SegmentSpec &s) {
+    switch(s.kind) {
+    case SegmentSpec::numeric:
+        return Segment::makeNumeric(std::string(s.data.begin(), s.data.end()).c_str());
+    case SegmentSpec::alphanumeric:
+        return Segment::makeAlphanumeric(std::string(s.data.begin(), s.data.end()).c_str());
+    case SegmentSpec::eci:
+        return Segment::makeEci(s.assignVal);
+    case SegmentSpec::kanji: {
+        std::vector<bool> bits;
+        for(size_t i = 0; i + 1 < s.data.size(); i += 2)
+            for(int b = 12; b >= 0; b--)
+                bits.push_back(((s.data[i] << 8 | s.data[i + 1]) >> b) & 1);
+        return Segment(Segment::Mode::KANJI, s.data.size() / 2, bits);
+    }
+    default:
+        return Segment::makeBytes(s.data);
+    }
+}
+
+template <typename Code, typename Segment> Result encode(const Case &c) {
+    Result r;
+    try {
+        const auto ecl = typename Code::Ecc(c.ecl);
+        // with the default arguments go through the convenience functions as well
+        const bool convenience = c.api != Case::segmentInput && c.minVersion == 1 && c.maxVersion == 40 && c.mask == -1 && c.boostEcl;
+        std::vector<Segment> segs;
+        if(c.api == Case::textInput)
+            segs = Segment::makeSegments(c.text.c_str());
+        else if(c.api == Case::binaryInput)
+            segs.push_back(Segment::makeBytes(c.binaryData));
+        else
+            for(const SegmentSpec &s : c.segs)
+                segs.push_back(makeSegment<Segment>(s));
+        const Code qr = !convenience     ? Code::encodeSegments(segs, ecl, c.minVersion, c.maxVersion, c.mask, c.boostEcl)
+            : c.api == Case::textInput ? Code::encodeText(c.text.c_str(), ecl)
+                                  : Code::encodeBinary(c.binaryData, ecl);
+        r.version = qr.getVersion();
+        r.ecl = int(qr.getErrorCorrectionLevel());
+        r.mask = qr.getMask();
+        r.size = qr.getSize();
+        r.modules.reserve(r.size * r.size);
+        for(int y = 0; y < r.size; y++)
+            for(int x = 0; x < r.size; x++)
+                r.modules.push_back(qr.getModule(x, y));
+    } catch(const std::length_error &) {
+        r = Result{Result::tooLong, 0, 0, 0, 0, {}};
+    } catch(const std::invalid_argument &) {
+        r = Result{Result::invalidArgument, 0, 0, 0, 0, {}};
+    } catch(const std::domain_error &) {
+        r = Result{Result::domainError, 0, 0, 0, 0, {}};
+    } catch(const std::exception &) {
+        r = Result{Result::other, 0, 0, 0, 0, {}};
+    }
+    return r;
+}
+
+/*---- Independent decoder ----*/
+
+// ISO/IEC 18004 table 9, index 0 is unused
+constexpr int8_t eccPerBlock[4][41] = {
+    {0, 7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {0, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28},
+    {0, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {0, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+};
+constexpr int8_t blockCount[4][41] = {
+    {0, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4, 4, 4, 4, 4, 6, 6, 6, 6, 7, 8, 8, 9, 9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25},
+    {0, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5, 5, 8, 9, 9, 10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49},
+    {0, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8, 8, 10, 12, 16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68},
+    {0, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81},
+};
+
+// GF(256) with the QR polynomial x^8 + x^4 + x^3 + x^2 + 1
+struct Galois {
+    std::array<uint8_t, 512> exp{};
+    std::array<uint8_t, 256> log{};
+
+    constexpr Galois() {
+        uint16_t v = 1;
+        for(size_t i = 0; i < 512; i++) {
+            exp[i] = v;
+            if(i < 255)
+                log[v] = i;
+            v <<= 1;
+            if(v & 0x100)
+                v ^= 0x11D;
+        }
+    }
+
+    constexpr uint8_t mul(uint8_t a, uint8_t b) const { return (a == 0 || b == 0) ? 0 : exp[log[a] + log[b]]; }
+};
+constexpr Galois gf;
+
+struct Decoded {
+    std::string error;
+    int version{0};
+    int ecl{0};
+    int mask{0};
+    std::vector<SegmentSpec> segs;
+};
+
+class Decoder {
+public:
+    Decoder(const Result &r) : size{r.size}, modules{r.modules}, function(r.modules.size()) { }
+
+    Decoded decode() {
+        Decoded d;
+        d.error = run(d);
+        return d;
+    }
+
+private:
+    int size;
+    const std::vector<bool> &modules;
+    std::vector<bool> function;
+    std::vector<bool> bits;
+    size_t bitPos{0};
+
+    bool dark(int x, int y) const { return modules[y * size + x]; }
+
+    void markFunction(int x0, int y0, int w, int h) {
+        for(int y = std::max(y0, 0); y < std::min(y0 + h, size); y++)
+            for(int x = std::max(x0, 0); x < std::min(x0 + w, size); x++)
+                function[y * size + x] = true;
+    }
+
+    static int formatWord(int data) {
+        int rem = data;
+        for(int i = 0; i < 10; i++)
+            rem = (rem << 1) ^ ((rem >> 9) * 0x537);
+        return (data << 10 | (rem & 0x3FF)) ^ 0x5412;
+    }
+
+    static int versionWord(int version) {
+        int rem = version;
+        for(int i = 0; i < 12; i++)
+            rem = (rem << 1) ^ ((rem >> 11) * 0x1F25);
+        return version << 12 | (rem & 0xFFF);
+    }
+
+    static bool maskBit(int mask, int x, int y) {
+        switch(mask) {
+        case 0:
+            return (y + x) % 2 == 0;
+        case 1:
+            return y % 2 == 0;
+        case 2:
+            return x % 3 == 0;
+        case 3:
+            return (y + x) % 3 == 0;
+        case 4:
+            return (y / 2 + x / 3) % 2 == 0;
+        case 5:
+            return (y * x) % 2 + (y * x) % 3 == 0;
+        case 6:
+            return ((y * x) % 2 + (y * x) % 3) % 2 == 0;
+        default:
+            return ((y + x) % 2 + (y * x) % 3) % 2 == 0;
+        }
+    }
+
+    std::vector<int> alignmentCenters(int version) const {
+        std::vector<int> centers;
+        if(version == 1)
+            return centers;
+        const int count = version / 7 + 2;
+        const int step = version == 32 ? 26 : (version * 4 + count * 2 + 1) / (count * 2 - 2) * 2;
+        centers.resize(count);
+        centers[0] = 6;
+        for(int i = count - 1, pos = size - 7; i >= 1; i--, pos -= step)
+            centers[i] = pos;
+        return centers;
+    }
+
+    uint32_t readBits(int n) {
+        uint32_t v = 0;
+        for(int i = 0; i < n; i++)
+            v = v << 1 | bits[bitPos++];
+        return v;
+    }
+
+    std::string run(Decoded &d) {
+        if(size < 21 || size > 177 || (size - 17) % 4)
+            return "bad size";
+        const int version = (size - 17) / 4;
+        d.version = version;
+
+        // finder patterns with separators, timing patterns and dark module
+        for(auto [fx, fy] : {std::pair{3, 3}, {size - 4, 3}, {3, size - 4}}) {
+            for(int dy = -4; dy <= 4; dy++) {
+                for(int dx = -4; dx <= 4; dx++) {
+                    const int x = fx + dx, y = fy + dy;
+                    if(x < 0 || y < 0 || x >= size || y >= size)
+                        continue;
+                    const int dist = std::max(std::abs(dx), std::abs(dy));
+                    if(dark(x, y) != (dist != 2 && dist != 4))
+                        return "finder pattern";
+                }
+            }
+        }
+        for(int i = 8; i < size - 8; i++)
+            if(dark(i, 6) != (i % 2 == 0) || dark(6, i) != (i % 2 == 0))
+                return "timing pattern";
+        if(!dark(8, size - 8))
+            return "dark module";
+        markFunction(0, 0, 9, 9);
+        markFunction(size - 8, 0, 8, 9);
+        markFunction(0, size - 8, 9, 8);
+        markFunction(6, 0, 1, size);
+        markFunction(0, 6, size, 1);
+
+        const std::vector<int> centers = alignmentCenters(version);
+        for(int cy : centers) {
+            for(int cx : centers) {
+                if((cx == 6 && cy == 6) || (cx == 6 && cy == size - 7) || (cx == size - 7 && cy == 6))
+                    continue;
+                for(int dy = -2; dy <= 2; dy++)
+                    for(int dx = -2; dx <= 2; dx++)
+                        if(dark(cx + dx, cy + dy) != (std::max(std::abs(dx), std::abs(dy)) != 1))
+                            return "alignment pattern";
+                markFunction(cx - 2, cy - 2, 5, 5);
+            }
+        }
+
+        if(version >= 7) {
+            const int word = versionWord(version);
+            for(int i = 0; i < 18; i++) {
+                const bool bit = (word >> i) & 1;
+                const int a = size - 11 + i % 3, b = i / 3;
+                if(dark(a, b) != bit || dark(b, a) != bit)
+                    return "version information";
+            }
+            markFunction(size - 11, 0, 3, 6);
+            markFunction(0, size - 11, 6, 3);
+        }
+
+        // both copies of the format information
+        int first = 0, second = 0;
+        for(int i = 0; i <= 5; i++)
+            first |= dark(8, i) << i;
+        first |= dark(8, 7) << 6 | dark(8, 8) << 7 | dark(7, 8) << 8;
+        for(int i = 9; i < 15; i++)
+            first |= dark(14 - i, 8) << i;
+        for(int i = 0; i < 8; i++)
+            second |= dark(size - 1 - i, 8) << i;
+        for(int i = 8; i < 15; i++)
+            second |= dark(8, size - 15 + i) << i;
+        if(first != second)
+            return "format copies differ";
+        int format = -1;
+        for(int data = 0; data < 32; data++)
+            if(formatWord(data) == first)
+                format = data;
+        if(format < 0)
+            return "format information";
+        static constexpr int eclFromBits[] = {1, 0, 3, 2};
+        d.ecl = eclFromBits[format >> 3];
+        d.mask = format & 7;
+
+        // zigzag scan of the data area
+        for(int right = size - 1; right >= 1; right -= 2) {
+            if(right == 6)
+                right = 5;
+            const bool upward = ((right + 1) & 2) == 0;
+            for(int i = 0; i < size; i++) {
+                const int y = upward ? size - 1 - i : i;
+                for(int x = right; x >= right - 1; x--)
+                    if(!function[y * size + x])
+                        bits.push_back(dark(x, y) ^ maskBit(d.mask, x, y));
+            }
+        }
+        const size_t rawCodewords = bits.size() / 8;
+        for(size_t i = rawCodewords * 8; i < bits.size(); i++)
+            if(bits[i])
+                return "remainder bits";
+        std::vector<uint8_t> raw(rawCodewords);
+        for(size_t i = 0; i < rawCodewords * 8; i++)
+            raw[i / 8] |= bits[i] << (7 - i % 8);
+
+        // de-interleave and check every block
+        const size_t blocks = blockCount[d.ecl][version];
+        const size_t eccLen = eccPerBlock[d.ecl][version];
+        const size_t shortBlocks = blocks - rawCodewords % blocks;
+        const size_t shortDataLen = rawCodewords / blocks - eccLen;
+        std::vector<std::vector<uint8_t>> block(blocks);
+        size_t k = 0;
+        for(size_t i = 0; i <= shortDataLen; i++)
+            for(size_t b = 0; b < blocks; b++)
+                if(i < shortDataLen || b >= shortBlocks)
+                    block[b].push_back(raw[k++]);
+        for(size_t i = 0; i < eccLen; i++)
+            for(size_t b = 0; b < blocks; b++)
+                block[b].push_back(raw[k++]);
+        if(k != rawCodewords)
+            return "block structure";
+
+        std::vector<uint8_t> data;
+        for(const auto &cw : block) {
+            for(size_t j = 0; j < eccLen; j++) {
+                uint8_t syndrome = 0;
+                for(uint8_t c : cw)
+                    syndrome = gf.mul(syndrome, gf.exp[j]) ^ c;
+                if(syndrome)
+                    return "reed-solomon syndrome";
+            }
+            data.insert(data.end(), cw.begin(), cw.end() - eccLen);
+        }
+        return parse(d, data);
+    }
+
+    std::string parse(Decoded &d, const std::vector<uint8_t> &data) {
+        bits.clear();
+        bitPos = 0;
+        for(uint8_t c : data)
+            for(int i = 7; i >= 0; i--)
+                bits.push_back((c >> i) & 1);
+        const int group = d.version < 10 ? 0 : d.version < 27 ? 1 : 2;
+        auto left = [&] { return bits.size() - bitPos; };
+
+        while(left() >= 4) {
+            const uint32_t mode = readBits(4);
+            if(mode == 0)
+                break;
+            SegmentSpec s{};
+            if(mode == 7) {
+                s.kind = SegmentSpec::eci;
+                if(left() < 8)
+                    return "eci truncated";
+                const uint32_t first = readBits(8);
+                const int more = (first & 0x80) == 0 ? 0 : (first & 0xC0) == 0x80 ? 8 : (first & 0xE0) == 0xC0 ? 16 : -1;
+                if(more < 0 || left() < size_t(more))
+                    return "eci designator";
+                s.assignVal = (first & (more == 0 ? 0x7F : more == 8 ? 0x3F : 0x1F)) << more | readBits(more);
+                d.segs.push_back(s);
+                continue;
+            }
+
+            static constexpr int countBits[][3] = {{10, 12, 14}, {9, 11, 13}, {8, 16, 16}, {8, 10, 12}};
+            static constexpr int unitBits[] = {0, 0, 8, 13};
+            int m;
+            switch(mode) {
+            case 1:
+                s.kind = SegmentSpec::numeric;
+                m = 0;
+                break;
+            case 2:
+                s.kind = SegmentSpec::alphanumeric;
+                m = 1;
+                break;
+            case 4:
+                s.kind = SegmentSpec::bytes;
+                m = 2;
+                break;
+            case 8:
+                s.kind = SegmentSpec::kanji;
+                m = 3;
+                break;
+            default:
+                return "unknown mode";
+            }
+            if(left() < size_t(countBits[m][group]))
+                return "count truncated";
+            size_t count = readBits(countBits[m][group]);
+            while(count > 0) {
+                // numeric packs 3 digits, alphanumeric 2 characters per unit
+                const size_t chars = m == 0 ? std::min<size_t>(count, 3) : m == 1 ? std::min<size_t>(count, 2) : 1;
+                const int n = m == 0 ? 3 * chars + 1 : m == 1 ? (chars == 2 ? 11 : 6) : unitBits[m];
+                if(left() < size_t(n))
+                    return "data truncated";
+                const uint32_t v = readBits(n);
+                if(m == 0) {
+                    if(v >= (chars == 3 ? 1000u : chars == 2 ? 100u : 10u))
+                        return "numeric value";
+                    for(size_t i = chars; i > 0; i--)
+                        s.data.push_back('0' + v / (i == 3 ? 100 : i == 2 ? 10 : 1) % 10);
+                } else if(m == 1) {
+                    if(v >= (chars == 2 ? 2025u : 45u))
+                        return "alphanumeric value";
+                    if(chars == 2)
+                        s.data.push_back(alphanumericCharset[v / 45]);
+                    s.data.push_back(alphanumericCharset[v % 45]);
+                } else if(m == 2) {
+                    s.data.push_back(v);
+                } else {
+                    s.data.push_back(v >> 8);
+                    s.data.push_back(v & 0xFF);
+                }
+                count -= chars;
+            }
+            d.segs.push_back(std::move(s));
+        }
+
+        // zero bits up to the byte boundary, then alternating pad codewords
+        while(bitPos % 8)
+            if(bitPos < bits.size() && bits[bitPos++])
+                return "terminator";
+        for(uint8_t pad = 0xEC; bitPos < bits.size(); pad ^= 0xEC ^ 0x11)
+            if(readBits(8) != pad)
+                return "padding";
+        return "";
+    }
+};
+
+/*---- Properties ----*/
+
+struct Counters {
+    size_t cases;
+    size_t encoded;
+    size_t rejected;
+} counters;
+
+[[noreturn]] void fail(const Case &c, const char *what, const std::string &detail = "") {
+    fprintf(stderr, "qrfuzz: %s %s\n  api %d ecl %d versions %d-%d mask %d boost %d segments %u text %u bytes %u\n", what, detail.c_str(), c.api, c.ecl,
+        c.minVersion, c.maxVersion, c.mask, c.boostEcl, unsigned(c.segs.size()), unsigned(c.text.size()), unsigned(c.binaryData.size()));
+    abort();
+}
+
+void check(const Case &c) {
+    counters.cases++;
+    const Result result = encode<qrcodegen::QrCode, qrcodegen::QrSegment>(c);
+    const Result reference = encode<qrreference::QrCode, qrreference::QrSegment>(c);
+    if(!(result == reference))
+        fail(c, "differs from the reference", result.error != reference.error ? "in the error" : "in the modules");
+    if(result.error != Result::none) {
+        counters.rejected++;
+        return;
+    }
+    counters.encoded++;
+
+    Decoded d = Decoder(result).decode();
+    if(!d.error.empty())
+        fail(c, "does not decode:", d.error);
+    if(d.version != result.version || d.ecl != result.ecl || d.mask != result.mask)
+        fail(c, "decoded version, ECC level or mask differ");
+    if(d.version < c.minVersion || d.version > c.maxVersion)
+        fail(c, "version out of range");
+    if(c.boostEcl ? d.ecl < c.ecl : d.ecl != c.ecl)
+        fail(c, "wrong ECC level");
+    if(c.mask != -1 && d.mask != c.mask)
+        fail(c, "wrong mask");
+
+    if(c.api == Case::segmentInput) {
+        if(d.segs != c.segs)
+            fail(c, "decoded segments differ");
+        return;
+    }
+    std::vector<uint8_t> content;
+    for(const SegmentSpec &s : d.segs)
+        content.insert(content.end(), s.data.begin(), s.data.end());
+    if(c.api == Case::textInput ? content != std::vector<uint8_t>(c.text.begin(), c.text.end()) : content != c.binaryData)
+        fail(c, "decoded content differs");
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    check(parseCase(data, size));
+    return 0;
+}
+
+#ifndef QRFUZZ_LIBFUZZER
+int main(int argc, char **argv) {
+    const size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 0) : 2000;
+    const unsigned seed = argc > 2 ? strtoul(argv[2], nullptr, 0) : std::random_device()();
+
+    // every version, ECC level and mask with a payload that fits version 1
+    for(int version = 1; version <= 40; version++) {
+        for(int ecl = 0; ecl < 4; ecl++) {
+            for(int mask = -1; mask <= 7; mask++) {
+                Case c{Case::textInput, ecl, version, version, mask, false, "ACME-0042", {}, {}};
+                check(c);
+            }
+        }
+    }
+
+    std::mt19937 rng(seed);
+    std::vector<uint8_t> input;
+    for(size_t i = 0; i < iterations; i++) {
+        // mostly receipt sized inputs, sometimes up to the largest symbols
+        input.resize(rng() % (rng() % 8 ? 300 : 4000));
+        for(uint8_t &b : input)
+            b = rng();
+        LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    printf("qrfuzz: seed %u, %u cases, %u encoded and decoded, %u rejected by both encoders\n", seed, unsigned(counters.cases), unsigned(counters.encoded),
+        unsigned(counters.rejected));
+    return 0;
+}
+#endif
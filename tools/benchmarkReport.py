@@ -0,0 +1,125 @@
+#!/usr/bin/env python3
+"""
+Turns the serial log of the benchmark firmware (pio run -e benchmark) into a
+machine-readable report. The captured command streams are replayed through
+the printer emulator to get bytes per graphic encoding and the modelled paper
+time of every job.
+
+    pio device monitor -e benchmark | tee bench.log
+    benchmarkReport.py bench.log --output report.json --baseline previous.json
+"""
+
+import argparse
+import json
+import os
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from printerEmulator import Printer, DEFAULT_HEAT_BUDGET  # noqa: E402
+
+ENCODINGS = ["uncompressed", "runLength", "tiff", "deltaRow"]
+# metrics compared against the baseline, lower is better for all of them
+METRICS = ["encode_us", "print_us", "rasterize_us", "compress_us", "transmit_us", "bytes", "paper_us"]
+
+
+def parse_log(lines):
+    meta = {}
+    jobs = {}
+    streams = {}
+    for line in lines:
+        line = line.strip()
+        if line.startswith("BENCH "):
+            entry = json.loads(line[6:])
+            if "job" in entry:
+                # only the timed pass reports, the streams come from a later pass
+                jobs[entry["job"]] = entry
+            else:
+                meta.update(entry)
+        elif line.startswith("DATA "):
+            _, job, data = line.split(" ", 2)
+            streams.setdefault(job, bytearray()).extend(bytes.fromhex(data))
+    return meta, jobs, streams
+
+
+def replay(stream, baud, heat_budget):
+    printer = Printer(baud, heat_budget)
+    printer.run(bytes(stream))
+    per_encoding = dict.fromkeys(ENCODINGS, 0)
+    encoding = 0
+    transfer = mechanical = 0
+    for cmd in printer.trace:
+        if cmd["cmd"] == "graphicMode" and cmd["args"][0] < len(ENCODINGS):
+            encoding = cmd["args"][0]
+        elif cmd["cmd"] == "printGraphicLine":
+            per_encoding[ENCODINGS[encoding]] += cmd["bytes"]
+        transfer += cmd["transfer_us"]
+        mechanical += cmd["mechanical_us"]
+    return {
+        "graphic_bytes": {k: v for k, v in per_encoding.items() if v},
+        "dot_lines": len(printer.lines),
+        "transfer_us": transfer,
+        "paper_us": printer.time,
+        "mechanical_us": mechanical,
+    }
+
+
+def compare(report, baseline, threshold):
+    regressions = []
+    old_jobs = baseline.get("jobs", {})
+    for job, result in report["jobs"].items():
+        old = old_jobs.get(job)
+        if old is None:
+            continue
+        for metric in METRICS:
+            new_value, old_value = result.get(metric), old.get(metric)
+            if new_value is None or not old_value:
+                continue
+            change = (new_value - old_value) / old_value
+            if change > threshold:
+                regressions.append(f"{job}.{metric}: {old_value} -> {new_value} (+{change:.1%})")
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", nargs="?", help="serial log of the benchmark firmware, - for stdin")
+    parser.add_argument("--baud", type=int, default=40000, help="link speed used for the transfer time")
+    parser.add_argument("--heat-budget", type=int, default=DEFAULT_HEAT_BUDGET, help="dots per strobe, 0 for unlimited")
+    parser.add_argument("--output", help="write the JSON report to this file instead of stdout")
+    parser.add_argument("--baseline", help="report of a previous run to compare against")
+    parser.add_argument("--threshold", type=float, default=0.05, help="relative increase reported as regression")
+    args = parser.parse_args()
+
+    if args.log in (None, "-"):
+        lines = sys.stdin.readlines()
+    else:
+        with open(args.log, "rt", errors="replace") as f:
+            lines = f.readlines()
+
+    meta, jobs, streams = parse_log(lines)
+    report = {"meta": meta, "baud": args.baud, "jobs": {}}
+    for job, result in jobs.items():
+        entry = dict(result)
+        entry.pop("job")
+        if job in streams:
+            entry.update(replay(streams[job], args.baud, args.heat_budget))
+        report["jobs"][job] = entry
+
+    text = json.dumps(report, indent=1)
+    if args.output:
+        with open(args.output, "wt") as f:
+            f.write(text)
+    else:
+        print(text)
+
+    if args.baseline:
+        with open(args.baseline, "rt") as f:
+            regressions = compare(report, json.load(f), args.threshold)
+        for r in regressions:
+            print(f"regression: {r}", file=sys.stderr)
+        if regressions:
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,209 @@
+Import("env")
+
+import os
+import re
+import struct
+import sys
+import textwrap
+
+# extra scripts run without their directory on the path
+sys.path.insert(0, env.subst("$PROJECT_DIR/tools"))
+from projectOptions import aslist
+
+
+
+def parse_charset(value):
+    """
+    Parses a list of code points and ranges like "0x20-0x7E 0xA0-0xFF 0x20AC".
+    Returns None if all glyphs of the font should be embedded.
+    """
+    ranges = []
+    for item in aslist(value):
+        lo, _, hi = item.partition("-")
+        ranges.append((int(lo, 0), int(hi or lo, 0)))
+    if not ranges:
+        return None
+    return lambda cp: any(lo <= cp <= hi for lo, hi in ranges)
+
+
+def load_bdf(path):
+    """
+    Reads a BDF font. Returns (height, ascent, glyphs) where glyphs maps the
+    code point to (width, height, xOffset, yOffset, advance, bitmap).
+    """
+    glyphs = {}
+    ascent = descent = 0
+    bbox_height = bbox_yoff = 0
+    with open(path, "rt", encoding="latin-1") as f:
+        lines = iter(f.read().splitlines())
+    for line in lines:
+        fields = line.split()
+        if not fields:
+            continue
+        if fields[0] == "FONTBOUNDINGBOX":
+            bbox_height, bbox_yoff = int(fields[2]), int(fields[4])
+        elif fields[0] == "FONT_ASCENT":
+            ascent = int(fields[1])
+        elif fields[0] == "FONT_DESCENT":
+            descent = int(fields[1])
+        elif fields[0] == "STARTCHAR":
+            cp = -1
+            w = h = xoff = yoff = advance = 0
+            rows = []
+            for line in lines:
+                fields = line.split()
+                if not fields:
+                    continue
+                if fields[0] == "ENCODING":
+                    cp = int(fields[-1])
+                elif fields[0] == "DWIDTH":
+                    advance = int(fields[1])
+                elif fields[0] == "BBX":
+                    w, h, xoff, yoff = (int(x) for x in fields[1:5])
+                elif fields[0] == "BITMAP":
+                    stride = (w + 7) // 8
+                    for _ in range(h):
+                        rows.append(bytes.fromhex(next(lines).strip())[:stride].ljust(stride, b"\0"))
+                elif fields[0] == "ENDCHAR":
+                    break
+            if cp >= 0:
+                # BDF counts the offset from the baseline upwards to the bottom of the bitmap
+                glyphs[cp] = (w, h, xoff, -(yoff + h), advance, b"".join(rows))
+    if ascent == 0 and descent == 0:
+        ascent, descent = bbox_height + bbox_yoff, -bbox_yoff
+    return ascent + descent, ascent, glyphs
+
+
+def load_psf(path):
+    """
+    Reads a PSF1 or PSF2 console font, using its unicode table if present.
+    """
+    with open(path, "rb") as f:
+        data = f.read()
+
+    if data[:2] == b"\x36\x04":
+        mode, charsize = data[2], data[3]
+        count = 512 if mode & 0x01 else 256
+        width, height, offset = 8, charsize, 4
+        table = offset + count * charsize
+        mapping = {}
+        if mode & 0x06:
+            pos = table
+            for idx in range(count):
+                while pos + 1 < len(data):
+                    (cp,) = struct.unpack_from("<H", data, pos)
+                    pos += 2
+                    if cp == 0xFFFF:
+                        break
+                    if cp != 0xFFFE:
+                        mapping.setdefault(cp, idx)
+    elif data[:4] == b"\x72\xb5\x4a\x86":
+        _, offset, flags, count, charsize, height, width = struct.unpack_from("<7I", data, 4)
+        table = offset + count * charsize
+        mapping = {}
+        if flags & 0x01:
+            pos = table
+            for idx in range(count):
+                end = data.index(b"\xff", pos)
+                # sequences after 0xFE describe combined glyphs, skip those
+                for ch in data[pos:end].split(b"\xfe")[0].decode("utf-8", "ignore"):
+                    mapping.setdefault(ord(ch), idx)
+                pos = end + 1
+    else:
+        raise ValueError(f"{path} is not a PSF font")
+
+    if not mapping:
+        mapping = {idx: idx for idx in range(count)}
+    glyphs = {}
+    for cp, idx in mapping.items():
+        bitmap = data[offset + idx * charsize:offset + (idx + 1) * charsize]
+        glyphs[cp] = (width, height, 0, -height, width, bitmap)
+    return height, height, glyphs
+
+
+def load_kerning(path):
+    """
+    Kerning is read from an optional "<font>.kern" file with lines of
+    "<left> <right> <adjust>", left and right being characters or code points.
+    """
+    pairs = {}
+    if not os.path.exists(path):
+        return pairs
+    def codepoint(x):
+        return ord(x) if len(x) == 1 else int(x, 0)
+    with open(path, "rt", encoding="utf-8") as f:
+        for line in f:
+            fields = line.split()
+            if len(fields) != 3 or fields[0].startswith("#"):
+                continue
+            pairs[(codepoint(fields[0]), codepoint(fields[1]))] = int(fields[2])
+    return pairs
+
+
+def convert(path, charset):
+    if path.lower().endswith(".bdf"):
+        height, ascent, glyphs = load_bdf(path)
+    else:
+        height, ascent, glyphs = load_psf(path)
+    if charset is not None:
+        glyphs = {cp: g for cp, g in glyphs.items() if charset(cp)}
+    kerning = {k: v for k, v in load_kerning(os.path.splitext(path)[0] + ".kern").items() if k[0] in glyphs and k[1] in glyphs}
+    return height, ascent, glyphs, kerning
+
+
+def render(file, height, ascent, glyphs, kerning):
+    var_name = re.sub('[^a-zA-Z0-9]+', '_', os.path.splitext(file)[0])
+    nl = "\n"
+    bitmap = bytearray()
+    table = []
+    for cp in sorted(glyphs):
+        w, h, xoff, yoff, advance, data = glyphs[cp]
+        table.append(f"{{0x{cp:04X}, {len(bitmap)}, {w}, {h}, {xoff}, {yoff}, {advance}}}")
+        bitmap += data
+
+    out = f"constexpr const uint8_t _bitmap_{var_name}_ [] = {{{nl}"
+    lst = ['0x{:02X}'.format(i) for i in bitmap] or ["0x00"]
+    out += "\n".join(textwrap.wrap(', '.join(lst), 180, initial_indent="    ", subsequent_indent="    "))
+    out += f"{nl}}};{nl}constexpr const raster::Glyph _glyphs_{var_name}_ [] = {{{nl}"
+    out += "\n".join(textwrap.wrap(', '.join(table), 180, initial_indent="    ", subsequent_indent="    "))
+    out += f"{nl}}};{nl}"
+    kern_name = "nullptr"
+    if kerning:
+        kern_name = f"_kerning_{var_name}_"
+        out += f"constexpr const raster::KerningPair {kern_name} [] = {{{nl}"
+        pairs = [f"{{0x{l:04X}, 0x{r:04X}, {a}}}" for (l, r), a in sorted(kerning.items())]
+        out += "\n".join(textwrap.wrap(', '.join(pairs), 180, initial_indent="    ", subsequent_indent="    "))
+        out += f"{nl}}};{nl}"
+    out += f"constexpr raster::Font {var_name} = {{{height}, {ascent}, {len(table)}, {len(kerning)}, _glyphs_{var_name}_, _bitmap_{var_name}_, {kern_name}}};{nl}{nl}"
+    return out
+
+
+input_fonts = aslist(env.GetProjectOption("embed_fonts", ""))
+charset = parse_charset(env.GetProjectOption("font_charset", ""))
+target_file = env.GetProjectOption("font_output", "src/fonts.h")
+
+HEADER = '''// Code generated by "fontConverter.py"; DO NOT EDIT.
+#pragma once
+
+#include "Raster.h"
+#include <Arduino.h>
+
+
+'''
+
+if input_fonts:
+    content = HEADER
+    for file in input_fonts:
+        content += render(file, *convert(file, charset))
+
+    # only touch the header if something changed, otherwise every build recompiles its users
+    try:
+        with open(target_file, "rt") as f:
+            current = f.read()
+    except OSError:
+        current = None
+
+    if current != content:
+        print(f"Embedding fonts: {', '.join(input_fonts)}")
+        with open(target_file, "wt") as f:
+            f.write(content)
@@ -1,7 +1,16 @@
 Import("env")
 
+import hashlib
+import json
+import os
 import re
+import sys
 import textwrap
+from concurrent.futures import ThreadPoolExecutor
+
+# extra scripts run without their directory on the path
+sys.path.insert(0, env.subst("$PROJECT_DIR/tools"))
+from projectOptions import aslist
 
 try:
     from PIL import Image
@@ -90,48 +99,89 @@ def encode(data):
     return bytes(result)
 
 
-def aslist_cronly(value):
-    if isinstance(value, str):
-        value = filter(None, [x.strip() for x in value.splitlines()])
-    return list(value)
-
-
-def aslist(value, flatten=True):
-    """ Return a list of strings, separating the input based on newlines
-    and, if flatten=True (the default), also split on spaces within
-    each line."""
-    values = aslist_cronly(value)
-    if not flatten:
-        return values
-    result = []
-    for value in values:
-        subvalues = value.split()
-        result.extend(subvalues)
-    return result
-
-
 def convert(path, convert, thresh):
     im = Image.open(path)
     if not convert:
-        assert (im.mode != "1"),"Only bilevel images can be embedded!\nEither convert to bilevel or enable automatic converting with convert_image = True"
+        assert (im.mode == "1"),"Only bilevel images can be embedded!\nEither convert to bilevel or enable automatic converting with convert_image = True"
     output = {"rowData": [], "data": bytearray()}
     if convert:
         print("Converting file to balck & white...")
         im = im.convert('L').point(lambda x: True if x > thresh else False , mode='1')
         #im.show()
-    img_array = np.array(im.getdata()).reshape((im.size[1], im.size[0]))
-    for imgRow in img_array:
-        packed = np.packbits(imgRow)
-        packBits = encode(packed)
+    # packbits works on the whole image at once, one packed row per image row
+    img_array = np.packbits(np.asarray(im, dtype=bool), axis=1)
+    for packed in img_array:
+        packBits = encode(packed.tobytes())
         output['rowData'].append(len(packBits))
         output['data'] += bytearray(packBits)
     return output
 
 
+def file_hash(path, convert, thresh):
+    """
+    Hashes the image content together with the conversion settings.
+    """
+    h = hashlib.sha256()
+    h.update(f"{CACHE_VERSION}:{bool(convert)}:{thresh}:".encode())
+    with open(path, "rb") as f:
+        for chunk in iter(lambda: f.read(65536), b""):
+            h.update(chunk)
+    return h.hexdigest()
+
+
+def load_cache(path):
+    try:
+        with open(path, "rt") as f:
+            cache = json.load(f)
+        if cache.get("version") == CACHE_VERSION:
+            return cache["images"]
+    except (OSError, ValueError, KeyError):
+        pass
+    return {}
+
+
+def save_cache(path, images):
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    tmp = path + ".tmp"
+    with open(tmp, "wt") as f:
+        json.dump({"version": CACHE_VERSION, "images": images}, f)
+    os.replace(tmp, path)
+
+
+def convert_cached(file, cache, convert_bw, threshold):
+    digest = file_hash(file, convert_bw, threshold)
+    entry = cache.get(file)
+    if entry is not None and entry["hash"] == digest:
+        return file, entry
+    print(f"Embedding: {file}")
+    data = convert(file, convert_bw, threshold)
+    return file, {"hash": digest, "rowData": data["rowData"], "data": data["data"].hex()}
+
+
+def render(file, entry):
+    var_name = re.sub('[^a-zA-Z0-9]+', '_', file)
+    bin_name = f"_binary_{var_name}_"
+    nl="\n"
+    data = bytes.fromhex(entry["data"])
+    rowData = entry["rowData"]
+
+    out = f"constexpr const uint8_t {bin_name} [] = {{{nl}"
+    lst = ['0x{:02X}'.format(i) for i in data]
+    out += "\n".join(textwrap.wrap(', '.join(lst), 180, initial_indent="    ", subsequent_indent="    "))
+    out += f"{nl}}};{nl}constexpr ThermalPrinter::tiffRaw<{len(rowData)}> {var_name} = {{{nl}    {{{{{nl}"
+    out += "\n".join(textwrap.wrap(", ".join(str(i) for i in rowData), 180, initial_indent="        ", subsequent_indent="        "))
+    out += f"{nl}    }}}},{nl}    {bin_name}{nl}}};{nl}{nl}"
+    return out
+
+
+CACHE_VERSION = 1
+
 input_images = aslist(env.GetProjectOption("embed_images"))
 convert_bw = env.GetProjectOption("convert_image", False)
 threshold = int(env.GetProjectOption("convert_threshold", 200))
 target_file = env.GetProjectOption("convert_output", "src/images.h")
+jobs = int(env.GetProjectOption("convert_jobs", 1))
+cache_file = os.path.join(env.subst("$PROJECT_BUILD_DIR"), "imageConverter.json")
 
 HEADER = '''// Code generated by "imageConverter.py"; DO NOT EDIT.
 #pragma once
@@ -142,19 +192,25 @@ HEADER = '''// Code generated by "imageConverter.py"; DO NOT EDIT.
 
 '''
 
-with open(target_file, "+wt") as f:
-    f.write(HEADER)
-    for file in input_images:
-        print(f"Embedding: {file}")
-        data = convert(file, convert_bw, threshold)
-        var_name = re.sub('[^a-zA-Z0-9]+', '_', file)
-        bin_name = f"_binary_{var_name}_"
-        nl="\n"
-
-        f.write(f"constexpr const uint8_t {bin_name} [] = {{{nl}")
-        lst = ['0x{:02X}'.format(i) for i in data["data"]]
-        f.write("\n".join(textwrap.wrap(', '.join(lst), 180, initial_indent="    ", subsequent_indent="    ")))
-        f.write(f"{nl}}};{nl}constexpr ThermalPrinter::tiffRaw<{len(data['rowData'])}> {var_name} = {{{nl}    {{{{{nl}")
-        f.write("\n".join(textwrap.wrap(", ".join(str(i) for i in data["rowData"]), 180, initial_indent="        ", subsequent_indent="        ")))
-        f.write(f"{nl}    }}}},{nl}    {bin_name}{nl}}};{nl}{nl}")
-        
+cache = load_cache(cache_file)
+if jobs > 1 and len(input_images) > 1:
+    with ThreadPoolExecutor(max_workers=jobs) as pool:
+        results = dict(pool.map(lambda f: convert_cached(f, cache, convert_bw, threshold), input_images))
+else:
+    results = dict(convert_cached(f, cache, convert_bw, threshold) for f in input_images)
+
+content = HEADER + "".join(render(file, results[file]) for file in input_images)
+
+# only touch the header if something changed, otherwise every build recompiles its users
+try:
+    with open(target_file, "rt") as f:
+        current = f.read()
+except OSError:
+    current = None
+
+if current != content:
+    with open(target_file, "wt") as f:
+        f.write(content)
+
+if results != cache:
+    save_cache(cache_file, results)
@@ -0,0 +1,452 @@
+#!/usr/bin/env python3
+"""
+Host side emulator for the thermal printer command set used by ThermalPrinter.
+
+Decodes a captured command stream (or a live stream over a pseudo terminal)
+into a PNG of the printed paper and a per command trace with a simulated
+mechanical time, using the same timing model as the library.
+
+    printerEmulator.py capture.bin --png out.png --trace out.json
+    printerEmulator.py --pty --png out.png
+"""
+
+import argparse
+import json
+import os
+import select
+import sys
+
+from PIL import Image, ImageDraw, ImageFont
+
+PX_LINE = 384
+LINE_BYTES = PX_LINE // 8
+ESC = 0x1B
+
+# timing model, keep in sync with ThermalPrinter.h
+DOT_FEED_TIME = 2100        # us per dot line
+DEFAULT_HEAT_BUDGET = 128   # dots per strobe
+CHAR_WIDTH = 16
+CHAR_HEIGHT = 24
+CUT_TIME = 500000           # us for the cutter
+
+# barcode module sizes selected by the size argument, see ThermalPrinter::getMaxSizeCode()
+BARCODE_SIZES = [(2, 5), (2, 6), (3, 7), (4, 9), (5, 12), (6, 14), (7, 16), (8, 18)]
+
+CODE39_ALPHABET = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ-. $/+%"
+CODE39_PATTERNS = [
+    0x034, 0x121, 0x061, 0x160, 0x031, 0x130, 0x070, 0x025, 0x124, 0x064, 0x109, 0x049, 0x148, 0x019, 0x118,
+    0x058, 0x00D, 0x10C, 0x04C, 0x01C, 0x103, 0x043, 0x142, 0x013, 0x112, 0x052, 0x007, 0x106, 0x046, 0x016,
+    0x181, 0x0C1, 0x1C0, 0x091, 0x190, 0x0D0, 0x085, 0x184, 0x0C4, 0x0A8, 0x0A2, 0x08A, 0x02A,
+]
+CODE39_ASTERISK = 0x094
+ITF_PATTERNS = [0x06, 0x11, 0x09, 0x18, 0x05, 0x14, 0x0C, 0x03, 0x12, 0x0A]
+EAN_L = ["3211", "2221", "2122", "1411", "1132", "1231", "1114", "1312", "1213", "3112"]
+EAN13_PARITY = [0x00, 0x0B, 0x0D, 0x0E, 0x13, 0x19, 0x1C, 0x15, 0x16, 0x1A]
+
+# number of argument bytes following the command character
+ARGS = {
+    '@': 0, 'A': 0, 'b': 7, 'C': 0, 'D': 1, 'e': 2, 'F': 2, 'g': 1, 'H': 1, 'I': 1, 'J': 1, 'k': 0, 'L': 1,
+    'l': 2, 'M': 1, 'm': 1, 'N': 2, 'n': 1, 'o': 2, 'P': 1, 'p': 1, 'R': 2, 'r': 1, 'S': 1, 's': 2, 'W': 1,
+    'Y': 1, '[': 2, '\\': 2,
+}
+
+NAMES = {
+    '@': "reset", 'A': "clearBuffer", 'b': "printBarcode", 'C': "cutPaper", 'D': "setUpsideDown", 'e': "sleepMode",
+    'F': "paperFeed", 'g': "printGraphicLine", 'H': "setCharHeight", 'I': "invert", 'J': "bold", 'k': "getStatus",
+    'L': "underline", 'l': "setPageLenght", 'M': "grayValue", 'm': "graphicMode", 'N': "setAbsoluteCursorPos",
+    'n': "serialEcho", 'o': "setPageStart", 'P': "setCharSet", 'p': "setLightBarrier", 'R': "relativeTabToDot",
+    'r': "setBatteryCircuit", 'S': "setHorizontalSpace", 's': "loadBatchfile", 'W': "doubleWidth",
+    'Y': "setBlackening", '[': "setPrintQuality", '\\': "reverseFeed",
+}
+
+
+def unpack_rle(data):
+    """ Run length pairs of (count - 1, byte). """
+    out = bytearray()
+    for i in range(0, len(data) - 1, 2):
+        out += bytes([data[i + 1]]) * (data[i] + 1)
+    return out
+
+
+def unpack_tiff(data):
+    """ PackBits, as produced by tools/imageConverter.py and raster::packBits(). """
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        n = data[i] - 256 if data[i] > 127 else data[i]
+        i += 1
+        if n >= 0:
+            out += data[i:i + n + 1]
+            i += n + 1
+        elif n != -128:
+            out += bytes([data[i]]) * (1 - n)
+            i += 1
+    return out
+
+
+def unpack_delta(data, seed):
+    """ Delta row: 3 bit count and 5 bit offset per command, relative to the previous line. """
+    out = bytearray(seed)
+    pos = 0
+    i = 0
+    while i < len(data):
+        count = (data[i] >> 5) + 1
+        offset = data[i] & 0x1F
+        i += 1
+        if offset == 31:
+            while i < len(data):
+                offset += data[i]
+                i += 1
+                if data[i - 1] != 255:
+                    break
+        pos += offset
+        for b in data[i:i + count]:
+            if pos < LINE_BYTES:
+                out[pos] = b
+            pos += 1
+        i += count
+    return out
+
+
+def barcode_elements(kind, text):
+    """ Element widths as (is_wide, ...) for the firmware barcodes, or None if unknown. """
+    if kind == 'a':
+        chars = [CODE39_ASTERISK] + [CODE39_PATTERNS[CODE39_ALPHABET.index(c)] for c in text if c in CODE39_ALPHABET] + [CODE39_ASTERISK]
+        out = []
+        for n, p in enumerate(chars):
+            if n:
+                out.append('n')
+            out += ['w' if p & (1 << i) else 'n' for i in range(8, -1, -1)]
+        return out
+    if kind == 'b':
+        digits = text if len(text) % 2 == 0 else "0" + text
+        out = list("nnnn")
+        for a, b in zip(digits[0::2], digits[1::2]):
+            pa, pb = ITF_PATTERNS[int(a)], ITF_PATTERNS[int(b)]
+            for i in range(4, -1, -1):
+                out += ['w' if pa & (1 << i) else 'n', 'w' if pb & (1 << i) else 'n']
+        return out + list("wnn")
+    if kind in "cd":
+        digits = [int(c) for c in text if c.isdigit()]
+        half = 6 if kind == 'c' else 4
+        first = 1 if kind == 'c' else 0
+        if len(digits) == first + 2 * half - 1:
+            # the printer adds the check digit, weights 3, 1, 3, ... from the right
+            total = sum(d * (3 if i % 2 == 0 else 1) for i, d in enumerate(reversed(digits)))
+            digits.append((10 - total % 10) % 10)
+        parity = EAN13_PARITY[digits[0]] if kind == 'c' and digits else 0
+        if len(digits) < first + 2 * half:
+            return None
+        out = [1, 1, 1]
+        for i in range(half):
+            widths = EAN_L[digits[first + i]]
+            if parity & (1 << (half - 1 - i)):
+                widths = widths[::-1]
+            out += [int(w) for w in widths]
+        out += [1, 1, 1, 1, 1]
+        for i in range(half):
+            out += [int(w) for w in EAN_L[digits[first + half + i]]]
+        return out + [1, 1, 1]
+    return None
+
+
+class Printer:
+    def __init__(self, baud, heat_budget):
+        self.byte_time = 10_000_000 // baud
+        self.heat_budget = heat_budget
+        self.lines = []
+        self.trace = []
+        self.time = 0
+        self.batch = b""
+        self.reset()
+
+    def reset(self):
+        self.encoding = 0
+        self.prev_line = bytearray(LINE_BYTES)
+        self.bold = self.underline = self.inverse = self.upside_down = self.double_width = False
+        self.zoom = 0
+        self.font = 0
+        self.spacing = 0
+        self.text = []
+        self.cursor = 0
+
+    # --- output -----------------------------------------------------------
+
+    def feed(self, dots):
+        if self.text:
+            self.flush_text()
+        self.lines += [bytearray(LINE_BYTES) for _ in range(dots)]
+        return dots * DOT_FEED_TIME
+
+    def graphic_line(self, line):
+        if self.text:
+            self.flush_text()
+        line = bytearray(line[:LINE_BYTES]).ljust(LINE_BYTES, b"\0")
+        self.prev_line = line
+        self.lines.append(line)
+        dots = sum(bin(b).count("1") for b in line)
+        strobes = max(1, -(-dots // self.heat_budget)) if self.heat_budget else 1
+        return strobes * DOT_FEED_TIME
+
+    def flush_text(self):
+        """ Renders the collected characters as one text line. """
+        scale_y = 1 << self.zoom
+        scale_x = 2 if self.double_width else 1
+        height = CHAR_HEIGHT * scale_y
+        im = Image.new("1", (PX_LINE, height), 0)
+        draw = ImageDraw.Draw(im)
+        font = ImageFont.load_default()
+        for x, ch, bold, underline, inverse in self.text:
+            w = (CHAR_WIDTH + self.spacing) * scale_x
+            cell = Image.new("1", (CHAR_WIDTH, CHAR_HEIGHT), 1 if inverse else 0)
+            cd = ImageDraw.Draw(cell)
+            cd.text((1, 4), ch, fill=0 if inverse else 1, font=font)
+            if bold:
+                cd.text((2, 4), ch, fill=0 if inverse else 1, font=font)
+            if underline:
+                cd.line((0, CHAR_HEIGHT - 2, CHAR_WIDTH, CHAR_HEIGHT - 2), fill=1)
+            im.paste(cell.resize((w, height)), (x, 0))
+        del draw
+        if self.upside_down:
+            im = im.rotate(180)
+        data = im.tobytes()
+        for y in range(height):
+            self.lines.append(bytearray(data[y * LINE_BYTES:(y + 1) * LINE_BYTES]))
+        self.text = []
+        self.cursor = 0
+        return height * DOT_FEED_TIME
+
+    def put_char(self, c):
+        if c == 0x0A:
+            return self.flush_text()
+        if c == 0x0D:
+            return 0
+        if c == 0x09:
+            self.cursor = (self.cursor // (8 * CHAR_WIDTH) + 1) * 8 * CHAR_WIDTH
+            return 0
+        ch = bytes([c]).decode("latin-1")
+        width = (CHAR_WIDTH + self.spacing) * (2 if self.double_width else 1)
+        if self.cursor + width > PX_LINE:
+            self.flush_text()
+        self.text.append((self.cursor, ch, self.bold, self.underline, self.inverse))
+        self.cursor += width
+        return 0
+
+    def barcode(self, kind, size, left, height, text):
+        if self.text:
+            self.flush_text()
+        narrow, wide = BARCODE_SIZES[min(size, len(BARCODE_SIZES) - 1)]
+        elements = barcode_elements(kind, text)
+        line = bytearray(LINE_BYTES)
+        if elements is not None:
+            x = left
+            for i, e in enumerate(elements):
+                w = (wide if e == 'w' else narrow) if isinstance(e, str) else e * narrow
+                if i % 2 == 0:
+                    for px in range(x, min(x + w, PX_LINE)):
+                        line[px // 8] |= 0x80 >> (px % 8)
+                x += w
+        self.lines += [bytearray(line) for _ in range(height)]
+        return height * DOT_FEED_TIME
+
+    # --- decoder ----------------------------------------------------------
+
+    def run(self, stream, flush=True):
+        """ Decodes a complete byte stream. """
+        i = 0
+        while i < len(stream):
+            start = i
+            if stream[i] != ESC:
+                mech = self.put_char(stream[i])
+                i += 1
+                self.record(start, "char", [stream[start]], 1, mech)
+                continue
+            if i + 1 >= len(stream):
+                break
+            c = chr(stream[i + 1])
+            n = ARGS.get(c)
+            if n is None:
+                self.record(start, f"unknown 0x{stream[i + 1]:02X}", [], 2, 0)
+                i += 2
+                continue
+            args = list(stream[i + 2:i + 2 + n])
+            i += 2 + n
+            mech = 0
+            if c == '@':
+                if self.text:
+                    self.flush_text()
+                self.reset()
+            elif c == 'F':
+                mech = self.feed((args[0] << 8) | args[1])
+            elif c == '\\':
+                # reverse feed takes paper back, the image keeps what was printed
+                mech = ((args[0] << 8) | args[1]) * DOT_FEED_TIME
+            elif c == 'C':
+                if self.text:
+                    self.flush_text()
+                mech = CUT_TIME
+            elif c == 'm':
+                self.encoding = args[0]
+            elif c == 'g':
+                data = stream[i:i + args[0]]
+                i += args[0]
+                if self.encoding == 1:
+                    line = unpack_rle(data)
+                elif self.encoding == 2:
+                    line = unpack_tiff(data)
+                elif self.encoding == 3:
+                    line = unpack_delta(data, self.prev_line)
+                else:
+                    line = data
+                mech = self.graphic_line(line)
+            elif c == 's':
+                length = (args[0] << 8) | args[1]
+                if length:
+                    self.batch = bytes(stream[i:i + length])
+                    i += length
+                elif self.batch:
+                    # executed from the printer's memory, only the mechanical time counts
+                    saved, self.batch = (self.trace, self.time, self.batch), b""
+                    self.trace, self.time = [], 0
+                    self.run(saved[2], flush=False)
+                    mech = sum(t["mechanical_us"] for t in self.trace)
+                    self.trace, self.time, self.batch = saved
+            elif c == 'b':
+                length = args[6]
+                text = stream[i:i + length].decode("latin-1")
+                i += length
+                mech = self.barcode(chr(args[0]), args[1], (args[2] << 8) | args[3], (args[4] << 8) | args[5], text)
+            elif c == 'N':
+                self.cursor = (args[0] << 8) | args[1]
+            elif c == 'J':
+                self.bold = args[0] in (1, ord('1'))
+            elif c == 'L':
+                self.underline = args[0] in (1, ord('1'))
+            elif c == 'I':
+                self.inverse = args[0] in (1, ord('1'))
+            elif c == 'D':
+                self.upside_down = args[0] in (1, ord('1'))
+            elif c == 'W':
+                self.double_width = args[0] in (1, ord('1'))
+            elif c == 'H':
+                self.zoom = min(args[0], 3)
+            elif c == 'P':
+                self.font = args[0]
+            elif c == 'S':
+                self.spacing = args[0]
+            self.record(start, NAMES[c], args, i - start, mech)
+        if flush and self.text:
+            self.flush_text()
+
+    def record(self, offset, name, args, length, mech):
+        transfer = length * self.byte_time
+        if self.trace and self.trace[-1]["cmd"] == "char" and name == "char" and mech == 0:
+            # plain text is merged into one entry per run
+            last = self.trace[-1]
+            last["bytes"] += length
+            last["transfer_us"] += transfer
+        else:
+            self.trace.append({"offset": offset, "cmd": name, "args": args, "bytes": length,
+                               "start_us": self.time, "transfer_us": transfer, "mechanical_us": mech})
+        self.time += transfer + mech
+
+    def image(self):
+        height = max(1, len(self.lines))
+        data = b"".join(bytes(l) for l in self.lines) or bytes(LINE_BYTES)
+        # 1 means a heated dot, which is black on paper
+        return Image.frombytes("1", (PX_LINE, height), data).point(lambda v: 0 if v else 255).convert("1")
+
+
+class Responder:
+    """
+    Answers status requests and serial echo probes of a live stream. Only the
+    command framing is tracked, so graphic and barcode payloads are skipped.
+    Status byte: 0x01 paper out, 0x02 busy, 0x04 buffer near full, 0x08 head
+    too hot, 0x80 buffer fill in percent and temperature in degree Celsius follow.
+    """
+
+    def __init__(self, paper=True, temperature=35):
+        self.paper = paper
+        self.temperature = temperature
+        self.pending = bytearray()
+
+    def feed(self, data):
+        self.pending += data
+        out = bytearray()
+        i = 0
+        while i < len(self.pending):
+            if self.pending[i] != ESC:
+                i += 1
+                continue
+            if i + 1 >= len(self.pending):
+                break
+            c = chr(self.pending[i + 1])
+            n = ARGS.get(c, 0)
+            if i + 2 + n > len(self.pending):
+                break
+            args = self.pending[i + 2:i + 2 + n]
+            payload = args[0] if c == 'g' else args[6] if c == 'b' else (args[0] << 8 | args[1]) if c == 's' else 0
+            if i + 2 + n + payload > len(self.pending):
+                break
+            if c == 'k':
+                out += bytes([0x80 | (0 if self.paper else 0x01), 0, self.temperature])
+            elif c == 'n':
+                out += args
+            i += 2 + n + payload
+        del self.pending[:i]
+        return bytes(out)
+
+
+def read_pty(idle, responder):
+    """ Opens a pseudo terminal and collects everything written to it until it is idle. """
+    master, slave = os.openpty()
+    print(f"Printer listening on {os.ttyname(slave)}", file=sys.stderr)
+    data = bytearray()
+    try:
+        while True:
+            ready, _, _ = select.select([master], [], [], idle if data else None)
+            if not ready:
+                break
+            chunk = os.read(master, 4096)
+            data += chunk
+            answer = responder.feed(chunk)
+            if answer:
+                os.write(master, answer)
+    except KeyboardInterrupt:
+        pass
+    return bytes(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", nargs="?", help="captured command stream, - for stdin")
+    parser.add_argument("--pty", action="store_true", help="read the stream live from a pseudo terminal")
+    parser.add_argument("--idle", type=float, default=2.0, help="seconds without data that end a --pty job")
+    parser.add_argument("--baud", type=int, default=40000, help="link speed used for the transfer time")
+    parser.add_argument("--heat-budget", type=int, default=DEFAULT_HEAT_BUDGET, help="dots per strobe, 0 for unlimited")
+    parser.add_argument("--no-paper", action="store_true", help="report paper out to status requests")
+    parser.add_argument("--png", help="write the printed paper to this file")
+    parser.add_argument("--trace", help="write the command trace as JSON to this file")
+    args = parser.parse_args()
+
+    if args.pty:
+        stream = read_pty(args.idle, Responder(paper=not args.no_paper))
+    elif args.capture in (None, "-"):
+        stream = sys.stdin.buffer.read()
+    else:
+        with open(args.capture, "rb") as f:
+            stream = f.read()
+
+    printer = Printer(args.baud, args.heat_budget)
+    printer.run(stream)
+
+    if args.png:
+        printer.image().save(args.png)
+    if args.trace:
+        with open(args.trace, "wt") as f:
+            json.dump({"bytes": len(stream), "total_us": printer.time, "commands": printer.trace}, f, indent=1)
+    print(f"{len(stream)} bytes, {len(printer.lines)} dot lines, {printer.time / 1e6:.3f} s simulated", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
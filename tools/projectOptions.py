@@ -0,0 +1,21 @@
+""" Helpers shared by the PlatformIO extra scripts to parse project options. """
+
+
+def aslist_cronly(value):
+    if isinstance(value, str):
+        value = filter(None, [x.strip() for x in value.splitlines()])
+    return list(value)
+
+
+def aslist(value, flatten=True):
+    """ Return a list of strings, separating the input based on newlines
+    and, if flatten=True (the default), also split on spaces within
+    each line."""
+    values = aslist_cronly(value)
+    if not flatten:
+        return values
+    result = []
+    for value in values:
+        subvalues = value.split()
+        result.extend(subvalues)
+    return result